@@ -1,4 +1,5 @@
 #include "BN.h"
+#include "Profiler.h"
 #include<string.h>
 
 
@@ -6,7 +7,7 @@ BN::BN()
 {
 }
 
-void BN::get_cpd_info()
+void BN::get_cpd_info() const
 {
 	for (int i = 0; i < cpd_list.size(); i++)
 	{
@@ -109,7 +110,7 @@ bool BN::check_model()
 		}
 		for (int i = 0; i < cpd_num; i++)
 		{
-			memset(flag_loop, 0, sizeof(flag_loop));
+			flag_loop.assign(cpd_list.size(), false);
 			if (check_loop(i) == 1)
 				error_checked = 2;
 		}
@@ -202,7 +203,7 @@ void BN::add_edge(CPD cpd_fa, CPD cpd_son)
 	cpd_list[cpd_map[cpd_son.cpd_name]].evidence_card.push_back(cpd_fa.variable_card);
 }
 
-double BN::query_discrete_cpd(CPD cpd_temp, map<string, double> evidence)
+double BN::query_discrete_cpd(const CPD &cpd_temp, map<string, double> &evidence) const
 {
 	int values_num = 1;
 	int values_loc = 0;
@@ -219,7 +220,7 @@ double BN::query_discrete_cpd(CPD cpd_temp, map<string, double> evidence)
 	}
 	return cpd_temp.values[int(evidence[cpd_temp.cpd_name])][values_loc];/**/
 }
-double BN::query_continuous_cpd(CPD cpd_temp, map<string, double>evidence)
+double BN::query_continuous_cpd(const CPD &cpd_temp, map<string, double> &evidence) const
 {
 	int father_num = cpd_temp.evidence_num;
 	double mean = cpd_temp.weights[0];
@@ -273,6 +274,7 @@ bool BN::check_loop(int beg)
 }
 void BN::readUAI(string filename)
 {
+	ProfileScope scope(Profiler::LOAD);
 	string type;
 	ifstream infile(filename);
 	//if (!infile) cout << "error" << endl;
@@ -7,7 +7,7 @@ class BN
 {
 public:
 	BN();
-	void get_cpd_info();
+	void get_cpd_info() const;
 	void add_cpds(int cpd_num, vector<CPD>temp_cpd);
 	vector<CPD> cpd_list;
 	map<string, int >cpd_map;
@@ -16,14 +16,14 @@ public:
 	bool model_checked;
 	bool check_model();
 	void add_edge(CPD cpd_fa, CPD cpd_son);
-	double query_discrete_cpd(CPD cpd_temp, map<string, double>evidence);
-	double query_continuous_cpd(CPD cpd_temp, map<string, double>evidence);
+	double query_discrete_cpd(const CPD &cpd_temp, map<string, double> &evidence) const;
+	double query_continuous_cpd(const CPD &cpd_temp, map<string, double> &evidence) const;
 
 	void readUAI(string filename);
 private:
 
 	double query_all_cpd(map<string, int>evidence);
 	bool check_loop(int beg);
-	bool flag_loop[100000];
+	vector<bool> flag_loop; // one per variable
 };
 
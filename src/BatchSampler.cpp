@@ -0,0 +1,203 @@
+#include "BatchSampler.h"
+#include "Profiler.h"
+
+BatchSampler::BatchSampler(const Sampler &model, unsigned long first, int lanes) : loaded(model)
+{
+	this->first = first;
+	this->lanes = lanes;
+	this->count = lanes;
+	this->NOW = 0;
+	this->NEXT = 1;
+	this->sample_size = 0;
+	this->model = model.model;
+	variable_num = model.variable_num;
+	keep = model.storeSteps != Sampler::STORE_NONE;
+	value[NOW].assign((size_t)variable_num * lanes, 0);
+	value[NEXT].assign((size_t)variable_num * lanes, 0);
+	// the initial values of every lane, the beta variables drawn from its trace
+	for (int l = 0; l < lanes; l++)
+	{
+		loaded.setTrace(first + l);
+		loaded.resetBeta();
+		for (int i = 0; i < variable_num; i++)
+			value[NOW][(size_t)i * lanes + l] = loaded.value[loaded.NOW][i];
+	}
+	int depth = 1;
+	for (int c = 0; c < variable_num; c++)
+	{
+		for (int k = 0; k < model.model->net_DBN.cpd_list[c].intervention.size(); k++)
+			depth = max(depth, model.model->net_DBN.cpd_list[c].intervention[k].depth);
+	}
+	stack.assign((size_t)depth * lanes, 0);
+	noise.assign(2 * lanes, 0);
+	noisePair = -1;
+}
+
+bool BatchSampler::supports(const Sampler &model)
+{
+	return model.sampler_type == 1;
+}
+
+Sampler BatchSampler::laneSampler(int lane)
+{
+	Sampler S = loaded;
+	S.setTrace(first + lane);
+	S.resetBeta();
+	return S;
+}
+
+void BatchSampler::get_one_sample()
+{
+	ProfileScope scope(Profiler::SIMULATE);
+	if (sample_size > 0)
+	{
+		int s = upper_bound(model->breakpoints.begin(), model->breakpoints.end(), sample_size) - model->breakpoints.begin() - 1;
+		const vector<int> &order = model->schedule[s];
+		noisePair = -1;
+		for (int j = 0; j < order.size(); j++)
+			Calculate(order[j]);
+		for (int i = 0; i < variable_num; i++)
+		{
+			const CPD &cpd = model->net_DBN.cpd_list[i];
+			const double *next = &value[NEXT][(size_t)i * lanes];
+			for (int l = 0; l < count && cpd.haveRange; l++)
+			{
+				if (!cpd.inRange(next[l]))
+				{
+					cout << "Error: Varriable " << cpd.cpd_name << " = " << next[l] << ", out of range." << endl;
+					exit(EXIT_FAILURE);
+				}
+			}
+		}
+		int t = NOW;
+		NOW = NEXT;
+		NEXT = t;
+	}
+	if (keep)
+		all_results.insert(all_results.end(), value[NOW].begin(), value[NOW].end());
+	sample_size++;
+}
+
+/**
+ * Sampler::Calculate() for the first count lanes of variable cpd_index, the
+ * result goes to value[NEXT]
+ */
+void BatchSampler::Calculate(int cpd_index)
+{
+	const CPD &cpd = model->net_DBN.cpd_list[cpd_index];
+	double *next = &value[NEXT][(size_t)cpd_index * lanes];
+	const double *now = &value[NOW][(size_t)cpd_index * lanes];
+	const Model::Segment &segment = model->segmentAt(cpd_index, sample_size, loaded.cursor[cpd_index]);
+	if (segment.operation == -1)
+	{
+		for (int l = 0; l < count; l++)
+			next[l] = now[l];
+		return;
+	}
+
+	const CPD::Operation &operation = cpd.intervention[segment.operation];
+	int top = 0;
+	for (int i = 0; i < operation.code.size(); i++)
+	{
+		const CPD::Instruction &ins = operation.code[i];
+		double *a = &stack[(size_t)top * lanes];
+		switch (ins.code)
+		{
+		case CPD::Instruction::LOAD_NOW:
+		case CPD::Instruction::LOAD_NEXT:
+		{
+			const double *v = &value[ins.code == CPD::Instruction::LOAD_NOW ? NOW : NEXT][(size_t)ins.slot * lanes];
+			for (int l = 0; l < count; l++)
+				a[l] = v[l];
+			top++;
+			break;
+		}
+		case CPD::Instruction::CONSTANT:
+			for (int l = 0; l < count; l++)
+				a[l] = ins.value;
+			top++;
+			break;
+		case CPD::Instruction::APPLY:
+		{
+			top--;
+			const double *b = a - lanes;
+			a = a - 2 * lanes;
+			switch (ins.op)
+			{
+			case '+':
+				for (int l = 0; l < count; l++)
+					a[l] = a[l] + b[l];
+				break;
+			case '-':
+				for (int l = 0; l < count; l++)
+					a[l] = a[l] - b[l];
+				break;
+			case '*':
+				for (int l = 0; l < count; l++)
+					a[l] = a[l] * b[l];
+				break;
+			case '/':
+				for (int l = 0; l < count; l++)
+					a[l] = a[l] / b[l];
+				break;
+			default:
+				for (int l = 0; l < count; l++)
+					a[l] = Execute(b[l], ins.op, a[l]);
+				break;
+			}
+			break;
+		}
+		case CPD::Instruction::UNKNOWN:
+			model->getVariableX(operation.Postfix[i].name);
+			break;
+		}
+	}
+	const double *expression = &stack[(size_t)(top - 1) * lanes];
+	if (!(sample_size == segment.first ? segment.noiseFirst : segment.noise))
+	{
+		for (int l = 0; l < count; l++)
+			next[l] = expression[l];
+	}
+	else
+	{
+		// the two variables of a Philox block are drawn together
+		if (noisePair != cpd_index >> 1)
+		{
+			noisePair = cpd_index >> 1;
+			RandomStream::normalLanes(first, count, noisePair, sample_size, &noise[0]);
+		}
+		const double *z = &noise[(cpd_index & 1) * count];
+		double var = operation.var;
+		for (int l = 0; l < count; l++)
+			next[l] = expression[l] + var * z[l];
+	}
+}
+
+void BatchSampler::saveSampleResult(int lane, string filename, int steps)
+{
+	ProfileScope scope(Profiler::SAVE);
+	ofstream file_out(filename);
+	const vector<string> &cpd_order = model->cpd_order;
+	for (int i = 0; i < cpd_order.size(); i++)
+	{
+		file_out << cpd_order[i];
+		if (i < cpd_order.size() - 1)
+			file_out << "\t";
+	}
+	file_out << endl;
+	for (int i = 0; i < steps; i++)
+	{
+		const double *row = &all_results[(size_t)i * variable_num * lanes];
+		for (int j = 0; j < cpd_order.size(); j++)
+		{
+			double v = row[(size_t)j * lanes + lane];
+			file_out << v;
+			if ((v - int(v)) == 0)
+				file_out << ".0";
+			if (j < cpd_order.size() - 1)
+				file_out << "\t";
+		}
+		file_out << endl;
+	}
+	file_out.close();
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "Sampler.h"
+
+/**
+ * Draws the traces of consecutive indices side by side: the lanes of a batch
+ * go through the steps of a DBN together.
+ *
+ * The state is stored variable by variable, the lanes of a variable next to
+ * each other, so that every instruction of a compiled operation runs once
+ * per step for all the lanes, in loops the compiler vectorizes. Lane l draws
+ * from the keyed stream of trace first + l, so it is exactly the trace the
+ * Sampler of that index draws.
+ */
+class BatchSampler : private Tools
+{
+public:
+	// lanes traces from first on, of model loaded with its initial values
+	BatchSampler(const Sampler &model, unsigned long first, int lanes);
+	// whether the traces of model can be batched: DBN models only
+	static bool supports(const Sampler &model);
+
+	unsigned long first;
+	int lanes;
+	int count; // the lanes still simulated, the first ones
+	int variable_num;
+	int sample_size;
+	shared_ptr<const Model> model;
+	bool keep; // whether the steps are kept, as the model keeps them
+
+	// the Sampler that draws the trace of lane from its first step, as long
+	// as no step was taken
+	Sampler laneSampler(int lane);
+	void get_one_sample();
+	double getValue(int lane, int variable) { return value[NOW][variable * lanes + lane]; }
+	// the first steps of the trace of lane, when kept
+	void saveSampleResult(int lane, string filename, int steps);
+
+private:
+	Sampler loaded; // the initial values, its cursors follow the steps of the lanes
+	int NOW;
+	int NEXT;
+	vector<double> value[2];    // [variable][lane], this step and the next one
+	vector<double> all_results; // [step][variable][lane]
+	vector<double> stack;       // [depth][lane], the operands of the operations
+	vector<double> noise;       // normal draws of the pair noisePair at the current step
+	int noisePair;
+	void Calculate(int cpd_index);
+};
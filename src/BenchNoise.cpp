@@ -0,0 +1,74 @@
+/**
+ * Microbenchmark of the noise of the samplers: the cost per variate of the
+ * sequential, keyed and bulk draws of RandomStream, for the sizes of the
+ * models given on the command line (default 16 256 4096 variables).
+ *
+ *     BenchNoise [variables ...]
+ *
+ * Every size draws the noise of as many steps as make about 2^24 variates,
+ * the way a step of a model draws it, and prints ns/variate.
+ */
+#include "Tools.h"
+#include "RandomStream.h"
+#include <chrono>
+#include <cstdio>
+
+// ns per variate of f(step, out) drawing n variates per step
+template <class F>
+static double timed(int n, F f)
+{
+	vector<double> out(2 * n);
+	int steps = max(1, (1 << 24) / n);
+	double sum = 0;
+	chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+	for (int s = 0; s < steps; s++)
+	{
+		f(s, &out[0]);
+		sum += out[s % n];
+	}
+	double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - begin).count();
+	// keeps the draws alive
+	if (sum == 0.123456789)
+		printf(" ");
+	return ns / ((double)steps * n);
+}
+
+int main(int argc, char *argv[])
+{
+	vector<int> sizes;
+	for (int i = 1; i < argc; i++)
+		sizes.push_back(atoi(argv[i]));
+	if (sizes.empty())
+		sizes = {16, 256, 4096};
+	RandomStream::setSeed(7);
+	Tools tools;
+	RandomStream rng(0);
+	printf("%10s %10s %10s %10s %10s %10s %10s\n", "variables", "gaussrand", "normal", "uniform", "normals", "uniforms", "lanes");
+	for (int k = 0; k < sizes.size(); k++)
+	{
+		int n = sizes[k];
+		if (n < 2)
+		{
+			cout << "Error: a size has at least 2 variables." << endl;
+			exit(EXIT_FAILURE);
+		}
+		double gauss = timed(n, [&](int s, double *out) {
+			for (int i = 0; i < n; i++)
+				out[i] = tools.gaussrand();
+		});
+		double normal = timed(n, [&](int s, double *out) {
+			for (int i = 0; i < n; i++)
+				out[i] = rng.normal(i, s);
+		});
+		double uniform = timed(n, [&](int s, double *out) {
+			for (int i = 0; i < n; i++)
+				out[i] = rng.uniform(i, s);
+		});
+		double normals = timed(n, [&](int s, double *out) { rng.normals(0, s, n, out); });
+		double uniforms = timed(n, [&](int s, double *out) { rng.uniforms(0, s, n, out); });
+		// the pair 0 of n traces, as BatchSampler draws it
+		double lanes = timed(n, [&](int s, double *out) { RandomStream::normalLanes(0, n / 2, 0, s, out); });
+		printf("%10d %10.2f %10.2f %10.2f %10.2f %10.2f %10.2f\n", n, gauss, normal, uniform, normals, uniforms, lanes);
+	}
+	return 0;
+}
@@ -277,7 +277,7 @@ void CPD::setRange(string s)
 	}
 	//cout<<haveRange<<" "<<rangeL<<" "<<rangeR<<endl;
 }
-bool CPD::inRange(double a)
+bool CPD::inRange(double a) const
 {
 	if (haveRange == false)
 		return true;
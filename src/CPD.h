@@ -21,6 +21,22 @@ public:
 		char op;
 		int type; // variable:0 num: 1 operator:2
 	};
+	// one instruction of a compiled Postfix, see Model::compile()
+	struct Instruction
+	{
+		enum Code
+		{
+			LOAD_NOW,  // push the value of variable slot at this step
+			LOAD_NEXT, // push the value of variable slot at the next step
+			CONSTANT,  // push value
+			APPLY,     // pop two operands and push their result by op
+			UNKNOWN    // a variable the model does not have, an error when reached
+		};
+		Code code;
+		int slot;
+		double value;
+		char op;
+	};
 	struct Operation
 	{
 		int begin_t;
@@ -28,6 +44,8 @@ public:
 		int func_type; // 0：普通连续 1：动态、高斯、连续
 		double var;
 		vector<Operator> Postfix;
+		vector<Instruction> code; // Postfix with the variables resolved
+		int depth;                // stack size needed by code
 	};
 	vector<Operation> intervention;
 	void set_cpd_info(int e_t, int b_t, string, int func_type);
@@ -44,7 +62,7 @@ public:
 	vector<double> weights;
 	void getExpectedBeta();
 	void setRange(string);
-	bool inRange(double);
+	bool inRange(double) const;
 	double rangeL;
 	double rangeR;
 	bool haveRange;
@@ -1,4 +1,5 @@
 #include "DBN.h"
+#include "Profiler.h"
 DBN::DBN()
 {
 }
@@ -37,6 +38,7 @@ void DBN::add_intervention(int b_t, int e_t, string inter_str, int func_type)
 }
 void DBN::getIntervention(string filename)
 {
+	ProfileScope scope(Profiler::LOAD);
 	ifstream fin(filename);
 	if (!fin)
 		return;
@@ -189,6 +191,7 @@ void DBN::getIntervention(string filename)
 }
 void DBN::load_network(string filename)
 {
+	ProfileScope scope(Profiler::LOAD);
 	//cout<<"123"<<endl;
 	ifstream fin(filename);
 	string s;
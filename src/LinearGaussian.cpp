@@ -0,0 +1,312 @@
+#include "LinearGaussian.h"
+#include "Profiler.h"
+#include <limits>
+
+LinearGaussian::LinearGaussian(Sampler &model, string variable, int step, int draws, uint64_t first)
+{
+	ProfileScope scope(Profiler::SIMULATE);
+	linear = false;
+	n = model.variable_num;
+	int target = model.getVariableX(variable);
+	const DBN &net_DBN = model.model->net_DBN;
+	if (model.sampler_type != 1)
+	{
+		why = "not a DBN";
+		return;
+	}
+	bool betas = false;
+	for (int c = 0; c < n; c++)
+		betas = betas || net_DBN.cpd_list[c].cpd_type == 2;
+	if (!betas)
+		draws = 1;
+
+	// row step - 1 of a trace is the state after step - 1 transitions
+	int transitions = step - 1;
+	Sampler S = model;
+	for (int d = 0; d < draws; d++)
+	{
+		S.setTrace(first + d);
+		S.resetBeta();
+		vector<double> m = S.value[S.NOW];
+		// forms[s] = distinct[of[s]]: the steps with the same key share them
+		vector<vector<Form> > distinct;
+		vector<int> of(transitions + 1, -1);
+		vector<int> key, last;
+		for (int s = 1; s <= transitions; s++)
+		{
+			key = stepKey(S, s);
+			if (distinct.empty() || key != last)
+			{
+				distinct.push_back(vector<Form>());
+				if (!stepForms(S, s, distinct.back()))
+					return;
+				last = key;
+			}
+			of[s] = distinct.size() - 1;
+			const vector<Form> &forms = distinct[of[s]];
+			vector<double> next(n);
+			for (int c = 0; c < n; c++)
+			{
+				double v = 0;
+				for (Form::const_iterator it = forms[c].begin(); it != forms[c].end(); it++)
+				{
+					if (it->first < n)
+						v += it->second * m[it->first];
+					else if (it->first == 2 * n)
+						v += it->second;
+				}
+				next[c] = v;
+			}
+			m = next;
+		}
+		// the variance of the target, from the noises of the last step back
+		vector<double> r(n, 0);
+		r[target] = 1;
+		double var = 0;
+		for (int s = transitions; s >= 1; s--)
+		{
+			const vector<Form> &forms = distinct[of[s]];
+			vector<double> w(n, 0), back(n, 0);
+			for (int c = 0; c < n; c++)
+			{
+				if (r[c] == 0)
+					continue;
+				for (Form::const_iterator it = forms[c].begin(); it != forms[c].end(); it++)
+				{
+					if (it->first < n)
+						back[it->first] += r[c] * it->second;
+					else if (it->first < 2 * n)
+						w[it->first - n] += r[c] * it->second;
+				}
+			}
+			for (int k = 0; k < n; k++)
+				var += w[k] * w[k];
+			r = back;
+		}
+		means.push_back(m[target]);
+		sds.push_back(sqrt(var));
+	}
+	linear = true;
+}
+
+vector<int> LinearGaussian::stepKey(Sampler &model, int step)
+{
+	vector<int> key(2 * n);
+	for (int c = 0; c < n; c++)
+	{
+		const Model::Segment &segment = model.model->segmentAt(c, step, model.cursor[c]);
+		key[2 * c] = segment.operation;
+		key[2 * c + 1] = step == segment.first ? segment.noiseFirst : segment.noise;
+	}
+	// the schedule too, as it orders the _next operands
+	const vector<int> &breakpoints = model.model->breakpoints;
+	key.push_back(upper_bound(breakpoints.begin(), breakpoints.end(), step) - breakpoints.begin());
+	return key;
+}
+/**
+ * the affine forms of the values of step, in the order of the schedule; false
+ * when an operation is not affine
+ */
+bool LinearGaussian::stepForms(Sampler &model, int step, vector<Form> &next)
+{
+	next.assign(n, Form());
+	const Model &m = *model.model;
+	// the constant of a form, and whether it is all of it
+	auto constant = [&](const Form &f) {
+		Form::const_iterator it = f.find(2 * n);
+		return it == f.end() ? 0.0 : it->second;
+	};
+	auto isConstant = [&](const Form &f) {
+		for (Form::const_iterator it = f.begin(); it != f.end(); it++)
+		{
+			if (it->first != 2 * n && it->second != 0)
+				return false;
+		}
+		return true;
+	};
+	int s = upper_bound(m.breakpoints.begin(), m.breakpoints.end(), step) - m.breakpoints.begin() - 1;
+	const vector<int> &order = m.schedule[s];
+	vector<Form> stack;
+	for (int j = 0; j < order.size(); j++)
+	{
+		int c = order[j];
+		const CPD &cpd = m.net_DBN.cpd_list[c];
+		Form &f = next[c];
+		const Model::Segment &segment = m.segmentAt(c, step, model.cursor[c]);
+		// kept values, among them the beta variables, fixed for the draw
+		if (cpd.cpd_type == 2)
+		{
+			f[2 * n] = model.value[model.NOW][c];
+			continue;
+		}
+		if (segment.operation == -1)
+		{
+			f[c] = 1;
+			continue;
+		}
+		const CPD::Operation &operation = cpd.intervention[segment.operation];
+		stack.clear();
+		for (int i = 0; i < operation.code.size(); i++)
+		{
+			const CPD::Instruction &ins = operation.code[i];
+			switch (ins.code)
+			{
+			case CPD::Instruction::LOAD_NOW:
+				stack.push_back(Form());
+				if (m.net_DBN.cpd_list[ins.slot].cpd_type == 2)
+					stack.back()[2 * n] = model.value[model.NOW][ins.slot];
+				else
+					stack.back()[ins.slot] = 1;
+				break;
+			case CPD::Instruction::LOAD_NEXT:
+				stack.push_back(next[ins.slot]);
+				break;
+			case CPD::Instruction::CONSTANT:
+				stack.push_back(Form());
+				stack.back()[2 * n] = ins.value;
+				break;
+			case CPD::Instruction::APPLY:
+			{
+				Form b = stack.back();
+				stack.pop_back();
+				Form &a = stack.back();
+				bool aConstant = isConstant(a), bConstant = isConstant(b);
+				if (ins.op == '+' || ins.op == '-')
+				{
+					double sign = ins.op == '+' ? 1 : -1;
+					for (Form::const_iterator it = b.begin(); it != b.end(); it++)
+						a[it->first] += sign * it->second;
+				}
+				else if (ins.op == '*' && (aConstant || bConstant))
+				{
+					double factor = aConstant ? constant(a) : constant(b);
+					if (aConstant)
+						a = b;
+					for (Form::iterator it = a.begin(); it != a.end(); it++)
+						it->second *= factor;
+				}
+				else if (ins.op == '/' && bConstant)
+				{
+					double divisor = constant(b);
+					for (Form::iterator it = a.begin(); it != a.end(); it++)
+						it->second /= divisor;
+				}
+				else if (aConstant && bConstant)
+				{
+					double value = Execute(constant(b), ins.op, constant(a));
+					a.clear();
+					a[2 * n] = value;
+				}
+				else
+				{
+					why = "the operation of " + cpd.cpd_name + " at step " + to_string(step) + " is not affine";
+					return false;
+				}
+				break;
+			}
+			case CPD::Instruction::UNKNOWN:
+				model.getVariableX(operation.Postfix[i].name);
+				break;
+			}
+		}
+		f = stack.back();
+		if (step == segment.first ? segment.noiseFirst : segment.noise)
+			f[n + c] += operation.var;
+	}
+	return true;
+}
+
+double LinearGaussian::average(const vector<double> &values, double *error)
+{
+	double sum = 0, sum2 = 0;
+	for (int i = 0; i < values.size(); i++)
+	{
+		sum += values[i];
+		sum2 += values[i] * values[i];
+	}
+	int D = values.size();
+	double mean = sum / D;
+	if (error != NULL)
+		*error = D < 2 ? 0 : 1.96 * sqrt(max(0.0, sum2 - D * mean * mean) / (D - 1) / D);
+	return mean;
+}
+
+double LinearGaussian::mean(double *error)
+{
+	return average(means, error);
+}
+
+double LinearGaussian::meanVariance()
+{
+	double error;
+	average(means, &error);
+	return error * error / (1.96 * 1.96);
+}
+
+double LinearGaussian::sd()
+{
+	double mu = mean(), sum = 0;
+	for (int i = 0; i < means.size(); i++)
+		sum += sds[i] * sds[i] + (means[i] - mu) * (means[i] - mu);
+	return sqrt(sum / means.size());
+}
+
+double LinearGaussian::cdf(int i, double x)
+{
+	if (sds[i] > 0)
+		return 0.5 * erfc(-(x - means[i]) / (sds[i] * sqrt(2.0)));
+	return x >= means[i];
+}
+
+double LinearGaussian::cdf(double x)
+{
+	double sum = 0;
+	for (int i = 0; i < means.size(); i++)
+		sum += cdf(i, x);
+	return sum / means.size();
+}
+
+// by bisection of the cdf, between bounds that hold all the normals
+double LinearGaussian::quantile(double p)
+{
+	double lo = numeric_limits<double>::max(), hi = -numeric_limits<double>::max();
+	for (int i = 0; i < means.size(); i++)
+	{
+		lo = min(lo, means[i] - 40 * sds[i]);
+		hi = max(hi, means[i] + 40 * sds[i]);
+	}
+	for (int i = 0; i < 200 && lo < hi; i++)
+	{
+		double mid = lo + (hi - lo) / 2;
+		if (mid <= lo || mid >= hi)
+			break;
+		if (cdf(mid) < p)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return hi;
+}
+
+double LinearGaussian::probability(vector<string> op, vector<double> x, double *error)
+{
+	if (error != NULL)
+		*error = 0;
+	double lo = -numeric_limits<double>::infinity(), hi = numeric_limits<double>::infinity();
+	for (int i = 0; i < op.size(); i++)
+	{
+		if (op[i] == ">" || op[i] == ">=")
+			lo = max(lo, x[i]);
+		else if (op[i] == "<" || op[i] == "<=")
+			hi = min(hi, x[i]);
+		else
+			return 0; // a single value of a continuous variable
+	}
+	if (lo >= hi)
+		return 0;
+	vector<double> p(means.size());
+	for (int i = 0; i < means.size(); i++)
+		p[i] = (hi == numeric_limits<double>::infinity() ? 1 : cdf(i, hi)) -
+		       (lo == -numeric_limits<double>::infinity() ? 0 : cdf(i, lo));
+	return average(p, error);
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "Sampler.h"
+
+/**
+ * Distribution of a variable of a DBN at a given step, in closed form, when
+ * every operation of the model is affine in the variables once the beta
+ * variables are fixed: the state is then Gaussian at every step, its mean is
+ * propagated forward and the variance of the variable backward through the
+ * steps.
+ *
+ * The beta variables are drawn as the traces first .. first + draws - 1 draw
+ * them, so the distribution is a mixture of one normal per draw: a Monte
+ * Carlo approximation of the distribution over the beta variables, whose
+ * error the half-widths of mean() and probability() give. Without beta
+ * variables one draw is exact.
+ */
+class LinearGaussian : private Tools
+{
+public:
+	// variable at step (as in Sampler::getResult), linear is false when an
+	// operation of the model is not affine, why tells which one
+	LinearGaussian(Sampler &model, string variable, int step, int draws, uint64_t first = 0);
+	bool linear;
+	string why;
+	vector<double> means; // of the normals of the mixture
+	vector<double> sds;   // their standard deviations
+
+	// whether the draws of the beta variables make it an approximation
+	bool mixture() const { return means.size() > 1; }
+	// error is set to the 95% half-width of the mean over the draws, 0 with
+	// one draw
+	double mean(double *error = NULL);
+	// the variance of mean() over the draws, 0 with one draw
+	double meanVariance();
+	double sd();
+	double cdf(double x);
+	double quantile(double p);
+	// probability that the variable satisfies all the comparisons op[i] x[i]
+	double probability(vector<string> op, vector<double> x, double *error = NULL);
+
+private:
+	int n; // variables of the model
+	// the affine form of one value, sparse as the rows of Model::CM: the
+	// coefficient of variable j at the step before at j, of the noise of
+	// variable j at n + j, the constant at 2n
+	typedef map<int, double> Form;
+	bool stepForms(Sampler &model, int step, vector<Form> &next);
+	// what stepForms() depends on at step: the segment of every variable and
+	// whether it draws its noise
+	vector<int> stepKey(Sampler &model, int step);
+	// of normal i of the mixture
+	double cdf(int i, double x);
+	// the mean of values, one per draw, and its half-width in error
+	static double average(const vector<double> &values, double *error);
+};
@@ -0,0 +1,428 @@
+#include "Model.h"
+
+Model::Model(string filename, string interfile)
+{
+	RandomStream rng; // trace 0
+	sampler_type = judge_file_type(filename);
+	if (sampler_type == 1)
+	{
+		net_DBN.load_network(filename);
+		net_DBN.getIntervention(interfile);
+		variable_num = net_DBN.cpd_list.size();
+		initial.assign(variable_num, 0);
+		for (int i = 0; i < variable_num; i++)
+		{
+			cpd_order.push_back(net_DBN.cpd_list[i].cpd_name);
+			variableIndex.insert(make_pair(net_DBN.cpd_list[i].cpd_name, i));
+			if (net_DBN.cpd_list[i].cpd_type != 2)
+				initial[i] = 1.0;
+			else
+				initial[i] = get_beta_value(i, rng.uniform(i, 0, 0), rng.uniform(i, 0, 1));
+		}
+		setMatrix();
+		compile();
+		buildSchedule();
+		buildTimeline();
+		buildNoise();
+	}
+	else if (sampler_type == 0)
+	{
+		net_BN.readUAI(filename);
+		variable_num = net_BN.cpd_list.size();
+		initial.assign(variable_num, 0);
+		for (int i = 0; i < variable_num; i++)
+		{
+			cpd_order.push_back(net_BN.cpd_list[i].cpd_name);
+			variableIndex.insert(make_pair(net_BN.cpd_list[i].cpd_name, i));
+			if (net_BN.cpd_list[i].cpd_type == 3)
+				initial[i] = int(rng.uniform(i, 0) * net_BN.cpd_list[i].variable_card);
+			else if (net_BN.cpd_list[i].cpd_type == 4)
+				initial[i] = net_BN.cpd_list[i].weights[0];
+		}
+	}
+}
+
+double Model::get_beta_value(int cpd_index, double u0, double u1) const
+{
+	const vector<double> &beta_value = net_DBN.cpd_list[cpd_index].beta_v;
+	const vector<double> &possiblelist = net_DBN.cpd_list[cpd_index].beta_p;
+	if (beta_value.size() != possiblelist.size() || beta_value.size() == 0)
+	{
+		cout << "Error: Wrong beta distribution input." << endl;
+		exit(EXIT_FAILURE);
+	}
+	//cout<<beta_value[0]<<" "<<possiblelist[0]<<endl;
+	double sumpossible = 0.0;
+	double randomfloatnum = u0;
+	int result = possiblelist.size() - 1;
+	for (int i = 0; i < possiblelist.size(); i++)
+	{
+		sumpossible += possiblelist[i];
+	}
+	randomfloatnum *= sumpossible;
+	for (int i = 0; i < possiblelist.size(); i++)
+	{
+		randomfloatnum -= possiblelist[i];
+		if (randomfloatnum < 0)
+		{
+			result = i;
+			break;
+		}
+		result = possiblelist.size() - 1;
+	}
+	double max = beta_value[result];
+	double min = beta_value[result - 1];
+	return (max - min) * u1 + min;
+}
+int Model::judge_file_type(string filename)
+{
+	ifstream fin(filename);
+	if (!fin)
+	{
+		cout << "Error: Wrong modelfile input." << endl;
+		exit(EXIT_FAILURE);
+		return 0;
+	}
+	string ss;
+	fin >> ss;
+	fin.close();
+	//cout << ss << endl;
+	if (ss == "BAYES")
+		return 0;
+	else
+		return 1;
+}
+int Model::getVariableX(string v) const
+{
+	//cout<<v<<endl;
+	map<string, int>::const_iterator it = variableIndex.find(v);
+	if (it != variableIndex.end())
+		return it->second;
+	cout << "Error Variable doesn't exist." << endl;
+	cout << "\"" << v << "\"" << endl;
+	exit(EXIT_FAILURE);
+	return 0;
+}
+/**
+ * compiles the Postfix of every operation of the DBN, once the model is
+ * loaded: the variables are resolved to their slot and to this or the next
+ * step, so that Calculate() never handles a name
+ */
+void Model::compile()
+{
+	for (int c = 0; c < net_DBN.cpd_list.size(); c++)
+	{
+		for (int k = 0; k < net_DBN.cpd_list[c].intervention.size(); k++)
+		{
+			CPD::Operation &operation = net_DBN.cpd_list[c].intervention[k];
+			operation.code.clear();
+			operation.depth = 0;
+			int top = 0;
+			for (int i = 0; i < operation.Postfix.size(); i++)
+			{
+				CPD::Instruction ins;
+				ins.slot = -1;
+				ins.value = 0;
+				ins.op = 0;
+				if (operation.Postfix[i].type == 0)
+				{
+					string var_name = operation.Postfix[i].name;
+					ins.code = CPD::Instruction::LOAD_NOW;
+					if (var_name.find("_next") != string::npos)
+					{
+						string_replace(var_name, "_next", "");
+						ins.code = CPD::Instruction::LOAD_NEXT;
+					}
+					map<string, int>::iterator it = variableIndex.find(var_name);
+					if (it == variableIndex.end())
+						ins.code = CPD::Instruction::UNKNOWN;
+					else
+						ins.slot = it->second;
+					top++;
+				}
+				else if (operation.Postfix[i].type == 1)
+				{
+					ins.code = CPD::Instruction::CONSTANT;
+					ins.value = operation.Postfix[i].value;
+					top++;
+				}
+				else
+				{
+					ins.code = CPD::Instruction::APPLY;
+					ins.op = operation.Postfix[i].op;
+					top--;
+				}
+				operation.depth = max(operation.depth, top);
+				operation.code.push_back(ins);
+			}
+		}
+	}
+}
+// the operation of variable cpd_index in force at step, -1 if none
+int Model::activeOperation(int cpd_index, int step)
+{
+	for (int i = net_DBN.cpd_list[cpd_index].intervention.size() - 1; i >= 0; i--)
+	{
+		if (net_DBN.cpd_list[cpd_index].intervention[i].begin_t <= step && (net_DBN.cpd_list[cpd_index].intervention[i].end_t > step || net_DBN.cpd_list[cpd_index].intervention[i].end_t < 0))
+			return i;
+	}
+	return -1;
+}
+/**
+ * orders the variables of a DBN step so that the _next operands of every
+ * variable are computed before it. The operations in force only change at
+ * the begin and end steps of the interventions, so there is one order per
+ * interval between them. A cycle of _next dependencies is an error.
+ */
+void Model::buildSchedule()
+{
+	breakpoints.assign(1, 0);
+	for (int c = 0; c < variable_num; c++)
+	{
+		for (int k = 0; k < net_DBN.cpd_list[c].intervention.size(); k++)
+		{
+			breakpoints.push_back(net_DBN.cpd_list[c].intervention[k].begin_t);
+			if (net_DBN.cpd_list[c].intervention[k].end_t >= 0)
+				breakpoints.push_back(net_DBN.cpd_list[c].intervention[k].end_t);
+		}
+	}
+	sort(breakpoints.begin(), breakpoints.end());
+	breakpoints.erase(unique(breakpoints.begin(), breakpoints.end()), breakpoints.end());
+	breakpoints.erase(breakpoints.begin(), lower_bound(breakpoints.begin(), breakpoints.end(), 0));
+	if (breakpoints.empty() || breakpoints[0] != 0)
+		breakpoints.insert(breakpoints.begin(), 0);
+
+	schedule.assign(breakpoints.size(), vector<int>());
+	for (int s = 0; s < breakpoints.size(); s++)
+	{
+		// the variables each one needs at the next step
+		vector<vector<int> > needs(variable_num);
+		for (int c = 0; c < variable_num; c++)
+		{
+			int k = activeOperation(c, breakpoints[s]);
+			if (net_DBN.cpd_list[c].cpd_type == 2 || k == -1)
+				continue;
+			const vector<CPD::Instruction> &code = net_DBN.cpd_list[c].intervention[k].code;
+			for (int i = 0; i < code.size(); i++)
+			{
+				if (code[i].code == CPD::Instruction::LOAD_NEXT)
+					needs[c].push_back(code[i].slot);
+			}
+		}
+
+		// depth first, in the order of the model, so that independent
+		// variables keep their order
+		vector<int> state(variable_num, 0); // 0 new, 1 on the path, 2 done
+		vector<int> path;
+		for (int root = 0; root < variable_num; root++)
+		{
+			if (state[root] != 0)
+				continue;
+			vector<pair<int, int> > stack(1, make_pair(root, 0)); // variable, next need
+			state[root] = 1;
+			path.assign(1, root);
+			while (!stack.empty())
+			{
+				int c = stack.back().first;
+				if (stack.back().second < needs[c].size())
+				{
+					int d = needs[c][stack.back().second++];
+					if (state[d] == 1)
+					{
+						string cycle;
+						for (int i = find(path.begin(), path.end(), d) - path.begin(); i < path.size(); i++)
+							cycle += cpd_order[path[i]] + "_next -> ";
+						Tools::fail("Error: cycle of _next dependencies from step " + to_string(breakpoints[s]) + ": " + cycle + cpd_order[d] + "_next");
+					}
+					if (state[d] == 0)
+					{
+						state[d] = 1;
+						stack.push_back(make_pair(d, 0));
+						path.push_back(d);
+					}
+				}
+				else
+				{
+					state[c] = 2;
+					schedule[s].push_back(c);
+					stack.pop_back();
+					path.pop_back();
+				}
+			}
+		}
+	}
+}
+/**
+ * cuts the steps of every variable of the DBN at the begin and end steps of
+ * its interventions. An operation makes its variable of its func_type (0
+ * without noise, 1 with) from the step after the first one it computes, so
+ * that the first computed step of a segment draws the noise as the segment
+ * before it does.
+ */
+void Model::buildTimeline()
+{
+	timeline.assign(variable_num, vector<Segment>());
+	for (int c = 0; c < variable_num; c++)
+	{
+		const CPD &cpd = net_DBN.cpd_list[c];
+		vector<int> begins(1, 0);
+		for (int k = 0; k < cpd.intervention.size() && cpd.cpd_type != 2; k++)
+		{
+			begins.push_back(cpd.intervention[k].begin_t);
+			if (cpd.intervention[k].end_t >= 0)
+				begins.push_back(cpd.intervention[k].end_t);
+		}
+		sort(begins.begin(), begins.end());
+		begins.erase(unique(begins.begin(), begins.end()), begins.end());
+		begins.erase(begins.begin(), lower_bound(begins.begin(), begins.end(), 0));
+
+		int type = cpd.cpd_type;
+		for (int i = 0; i < begins.size(); i++)
+		{
+			Segment segment;
+			segment.begin = begins[i];
+			segment.first = max(begins[i], 1);
+			segment.operation = cpd.cpd_type == 2 ? -1 : activeOperation(c, begins[i]);
+			segment.noiseFirst = segment.noise = false;
+			if (segment.operation != -1)
+			{
+				segment.noiseFirst = (type != 0);
+				// a segment before the first computed step does not set the type
+				if (i + 1 == begins.size() || segment.first < begins[i + 1])
+					type = cpd.intervention[segment.operation].func_type;
+				segment.noise = (type != 0);
+			}
+			timeline[c].push_back(segment);
+		}
+	}
+}
+// the segment of variable cpd_index at step, searched from segment at, the
+// one of a previous step, and stored there
+const Model::Segment &Model::segmentAt(int cpd_index, int step, int &at) const
+{
+	const vector<Segment> &segments = timeline[cpd_index];
+	if (segments[at].begin > step)
+		at = 0;
+	while (at + 1 < segments.size() && segments[at + 1].begin <= step)
+		at++;
+	return segments[at];
+}
+// appends variable c to the runs of consecutive variables
+static void addToRuns(vector<pair<int, int> > &runs, int c)
+{
+	if (runs.empty() || runs.back().first + runs.back().second != c)
+		runs.push_back(make_pair(c, 0));
+	runs.back().second++;
+}
+/**
+ * the noisy variables of every kind of step, from the segments in force at
+ * the breakpoints: no segment begins between two breakpoints
+ */
+void Model::buildNoise()
+{
+	int kinds = 2 * breakpoints.size();
+	draws.assign(kinds, vector<bool>(variable_num, false));
+	noise.assign(kinds, vector<pair<int, int> >());
+	for (int k = 0; k < kinds; k++)
+	{
+		int s = k / 2;
+		int step = max(breakpoints[s], 1);
+		for (int c = 0; c < variable_num; c++)
+		{
+			int at = 0;
+			const Segment &segment = segmentAt(c, breakpoints[s], at);
+			if (net_DBN.cpd_list[c].cpd_type == 2 || segment.operation == -1)
+				continue;
+			draws[k][c] = (k % 2 == 0 && step == segment.first) ? segment.noiseFirst : segment.noise;
+			if (draws[k][c])
+				addToRuns(noise[k], c);
+		}
+	}
+	for (int c = 0; c < variable_num; c++)
+		if (net_DBN.cpd_list[c].cpd_type == 2)
+			addToRuns(betas, c);
+}
+int Model::kindAt(int step) const
+{
+	int s = upper_bound(breakpoints.begin(), breakpoints.end(), step) - breakpoints.begin() - 1;
+	return 2 * s + (step == max(breakpoints[s], 1) ? 0 : 1);
+}
+void Model::setMatrix()
+{
+	variable_num = net_DBN.cpd_list.size();
+	flagLR.assign(variable_num, 0);
+	for (int i = 0; i < variable_num; i++)
+	{
+		net_DBN.cpd_list[i].var = 0;
+		if(net_DBN.cpd_list[i].intervention.size()!=0)
+		    net_DBN.cpd_list[i].var = net_DBN.cpd_list[i].intervention[0].var;
+		var.push_back(net_DBN.cpd_list[i].var);
+        CM.push_back(map<int, double>());
+		if (net_DBN.cpd_list[i].cpd_type == 2||net_DBN.cpd_list[i].pns.size()==0)
+		{
+			net_DBN.cpd_list[i].setBetaPN();
+		}
+		flagLR[i] = 1;
+		int k = net_DBN.cpd_list[i].pns.size();
+		for(int j=0;j<k;j++)
+		{
+			string::size_type nPos1 = 0;
+	        nPos1 = net_DBN.cpd_list[i].pns[j].name.find("_next", nPos1);
+	        if (nPos1 == string::npos&&net_DBN.cpd_list[i].pns[j].type!=2)
+			{
+                flagLR[i] = 0;
+				//cout<<"type: "<<net_DBN.cpd_list[i].pns[j].type<<endl;
+				break;
+			}
+		}
+		//cout<<"flag:  "<<flagLR[i]<<endl;
+	}
+	for (int i = 0; i < variable_num; i++)
+	{
+		int k = net_DBN.cpd_list[i].pns.size();
+		int j = 0;
+		if(flagLR[i]==1)
+		{
+            CM[i][i] = 1;
+			continue;
+		}
+		while (j < k)
+		{
+			//cout<<i<<" "<<j<<" "<<endl;
+			//cout<<net_DBN.cpd_list[i].cpd_name<<" "<<net_DBN.cpd_list[i].pns[j].name<<" "<<net_DBN.cpd_list[i].pns[j].type<<endl;
+			if(net_DBN.cpd_list[i].pns[j].type == 1)
+			{
+				int indt = getVariableX(net_DBN.cpd_list[i].pns[j].beta);
+				net_DBN.cpd_list[i].pns[j].c *= initial[indt];
+			}
+			else if(net_DBN.cpd_list[i].pns[j].type == 2)
+			{
+                CM[i][variable_num] += net_DBN.cpd_list[i].pns[j].c;
+				j++;
+				continue;
+			}
+			string::size_type nPos1 = 0;
+	        nPos1 = net_DBN.cpd_list[i].pns[j].name.find("_next", nPos1);
+	        if (nPos1 != string::npos)
+			{
+				//cout<<"123"<<endl;
+				string_replace(net_DBN.cpd_list[i].pns[j].name,"_next","");
+				int indt = getVariableX(net_DBN.cpd_list[i].pns[j].name); 
+				//cout<<indt<<" "<< net_DBN.cpd_list[i].pns[i].name<<" "<<net_DBN.cpd_list[indt].pns.size()<<endl;
+				for(int ij = 0;ij<net_DBN.cpd_list[indt].pns.size();ij++)
+				{
+					net_DBN.cpd_list[indt].pns[ij].c *= net_DBN.cpd_list[i].pns[j].c;
+					net_DBN.cpd_list[i].pns.push_back(net_DBN.cpd_list[indt].pns[ij]);
+					k++;
+				}
+			}
+			else
+			{
+				int indt = getVariableX(net_DBN.cpd_list[i].pns[j].name);
+                CM[i][indt] += net_DBN.cpd_list[i].pns[j].c;
+                var[i] += net_DBN.cpd_list[i].pns[j].c * var[indt];
+			}
+			j++;		
+		}
+	}
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include "DBN.h"
+#include "BN.h"
+#include "CPD.h"
+#include "RandomStream.h"
+
+/**
+ * A model file with its interventions, loaded and compiled once: the network,
+ * the compiled operations, the evaluation order and the timeline of the
+ * operations in force. It is never written once built, so that every Sampler
+ * drawing a trace of it shares it and only holds the state of its trace.
+ */
+class Model : private Tools
+{
+public:
+	Model(string filename, string interfile);
+	DBN net_DBN;
+	BN net_BN;
+	int sampler_type; //0:BN  1:DBN
+	int variable_num;
+	vector<string> cpd_order;
+	map<string, int> variableIndex; // slot of every name of cpd_order
+	// the values a trace starts from before the initial file, the beta
+	// variables drawn as trace 0 draws them
+	vector<double> initial;
+	int getVariableX(string v) const;
+	// a value of beta variable cpd_index from its uniform draws 0 and 1 of
+	// step 0
+	double get_beta_value(int cpd_index, double u0, double u1) const;
+	vector<pair<int, int> > betas; // runs (first variable, count) of the beta variables
+
+	// evaluation order of the variables of a DBN step: from step
+	// breakpoints[s] on, schedule[s] puts every variable after the ones its
+	// _next operands refer to
+	vector<int> breakpoints;
+	vector<vector<int> > schedule;
+	// the steps of a variable of the DBN with the same operation in force
+	struct Segment
+	{
+		int begin;       // from this step to the begin of the next segment
+		int first;       // first step of the segment computed by Calculate()
+		int operation;   // index in intervention, -1 if none: the value is kept
+		bool noiseFirst; // whether the noise is drawn at step first
+		bool noise;      // whether it is drawn at the other steps
+	};
+	// timeline[c], the segments of variable c
+	vector<vector<Segment> > timeline;
+	const Segment &segmentAt(int cpd_index, int step, int &at) const;
+	// the kinds of step, two per interval between breakpoints: its first
+	// computed step and the others. draws[k][c] tells whether variable c
+	// draws its noise at a step of kind k, noise[k] holds the runs (first
+	// variable, count) of those variables, drawn in bulk before the step
+	int kindAt(int step) const;
+	vector<vector<bool> > draws;
+	vector<vector<pair<int, int> > > noise;
+
+	// the linear system of the backward sampling, with the beta variables of
+	// initial; the pns of net_DBN are its coefficients
+	vector<map<int, double> > CM; // sparse rows, made dense for LE when needed
+	vector<double> var;
+	vector<int> flagLR;
+
+private:
+	int judge_file_type(string);
+	void compile();
+	int activeOperation(int cpd_index, int step);
+	void buildSchedule();
+	void buildTimeline();
+	void buildNoise();
+	void setMatrix();
+};
@@ -0,0 +1,207 @@
+#include "NativeModel.h"
+#include <sstream>
+#include <cmath>
+#include <cstdio>
+#include <unistd.h>
+#include <dlfcn.h>
+
+// a double literal that reads back to the same value
+static string literal(double v)
+{
+	ostringstream out;
+	out.precision(17);
+	out << v;
+	string s = out.str();
+	if (s.find_first_of(".e") == string::npos)
+		s += ".0";
+	return v < 0 ? "(" + s + ")" : s;
+}
+
+// ends the part in body: called by the kernel, emitted to out unless an
+// equal part is already there
+static void addPart(ostringstream &out, vector<string> &parts, vector<int> &called, ostringstream &body)
+{
+	int i = find(parts.begin(), parts.end(), body.str()) - parts.begin();
+	if (i == parts.size())
+	{
+		out << "__attribute__((noinline)) static void part" << i << "(const double *now, double *next, const double *noise)\n{\n";
+		out << body.str() << "}\n";
+		parts.push_back(body.str());
+	}
+	called.push_back(i);
+	body.str("");
+}
+
+string NativeModel::source(const Model &model, string &why)
+{
+	if (model.sampler_type != 1)
+	{
+		why = "not a DBN";
+		return "";
+	}
+	ostringstream out;
+	out << "// the steps of a DBN, generated by SMC_wm from its compiled operations\n";
+	out << "#include <cmath>\n\n";
+	int kernels = model.draws.size();
+	// a kernel calls parts of at most PART statements, so that the compiler
+	// never sees a function as large as the model; the kernels share their
+	// equal parts and their equal sequences of parts
+	const int PART = 256;
+	vector<string> parts;
+	vector<vector<int> > calls;
+	vector<int> same; // the first kernel that calls the same parts
+	for (int k = 0; k < kernels; k++)
+	{
+		int s = k / 2;
+		const vector<bool> &draws = model.draws[k];
+		ostringstream body;
+		vector<int> called;
+		const vector<int> &order = model.schedule[s];
+		for (int j = 0; j < order.size(); j++)
+		{
+			if (j > 0 && j % PART == 0)
+				addPart(out, parts, called, body);
+			int c = order[j];
+			const CPD &cpd = model.net_DBN.cpd_list[c];
+			int at = 0;
+			const Model::Segment &segment = model.segmentAt(c, model.breakpoints[s], at);
+			if (cpd.cpd_type == 2 || segment.operation == -1)
+			{
+				body << "\tnext[" << c << "] = now[" << c << "];\n";
+				continue;
+			}
+			// the operands of the compiled Postfix become nested expressions,
+			// evaluated in the same order
+			const CPD::Operation &operation = cpd.intervention[segment.operation];
+			vector<string> stack;
+			for (int i = 0; i < operation.code.size(); i++)
+			{
+				const CPD::Instruction &ins = operation.code[i];
+				switch (ins.code)
+				{
+				case CPD::Instruction::LOAD_NOW:
+					stack.push_back("now[" + to_string(ins.slot) + "]");
+					break;
+				case CPD::Instruction::LOAD_NEXT:
+					stack.push_back("next[" + to_string(ins.slot) + "]");
+					break;
+				case CPD::Instruction::CONSTANT:
+					if (!std::isfinite(ins.value))
+					{
+						why = "a constant of " + cpd.cpd_name + " is not finite";
+						return "";
+					}
+					stack.push_back(literal(ins.value));
+					break;
+				case CPD::Instruction::APPLY:
+				{
+					string b = stack.back();
+					stack.pop_back();
+					string a = stack.back();
+					if (ins.op == '+' || ins.op == '-' || ins.op == '*' || ins.op == '/')
+						stack.back() = "(" + a + " " + ins.op + " " + b + ")";
+					else if (ins.op == '^')
+						stack.back() = "pow(" + a + ", " + b + ")";
+					else
+					{
+						why = string("operator ") + ins.op + " of " + cpd.cpd_name;
+						return "";
+					}
+					break;
+				}
+				case CPD::Instruction::UNKNOWN:
+					why = "unknown variable " + operation.Postfix[i].name + " in " + cpd.cpd_name;
+					return "";
+				}
+			}
+			body << "\tnext[" << c << "] = " << stack.back();
+			if (draws[c])
+				body << " + " << literal(operation.var) << " * noise[" << c << "]";
+			body << ";\n";
+		}
+		addPart(out, parts, called, body);
+		same.push_back(find(calls.begin(), calls.end(), called) - calls.begin());
+		calls.push_back(called);
+		if (same.back() == k)
+		{
+			out << "static void step" << k << "(const double *now, double *next, const double *noise)\n{\n";
+			for (int i = 0; i < called.size(); i++)
+				out << "\tpart" << called[i] << "(now, next, noise);\n";
+			out << "}\n";
+		}
+	}
+	out << "\nextern \"C\" const int smc_abi = " << ABI << ";\n";
+	out << "extern \"C\" const int smc_kernel_count = " << kernels << ";\n";
+	out << "extern \"C\" void (*const smc_kernels[])(const double *, double *, const double *) = {";
+	for (int k = 0; k < kernels; k++)
+		out << (k > 0 ? ", " : "") << "step" << same[k];
+	out << "};\n";
+	return out.str();
+}
+
+string NativeModel::build(const Model &model, string directory, string &why)
+{
+	string code = source(model, why);
+	if (code == "")
+		return "";
+	// FNV-1a of the source: the same model gets the same file
+	unsigned long long hash = 14695981039346656037ULL;
+	for (int i = 0; i < code.size(); i++)
+		hash = (hash ^ (unsigned char)code[i]) * 1099511628211ULL;
+	char name[32];
+	snprintf(name, sizeof(name), "model_%016llx", hash);
+	string base = directory + "/" + name;
+	string library = base + ".so";
+	if (access(library.c_str(), R_OK) == 0)
+		return library;
+
+	Tools tools;
+	tools.creatFolder(directory);
+	ofstream file(base + ".cpp");
+	file << code;
+	file.close();
+	if (!file)
+	{
+		why = "cannot write " + base + ".cpp";
+		return "";
+	}
+	// built under a name of its own and renamed, for the workers that build
+	// the same model at the same time
+	const char *cxx = getenv("CXX");
+	string partial = library + "." + to_string(getpid());
+	string command = string(cxx != NULL ? cxx : "g++") + " -O2 -ffp-contract=off -fPIC -shared -o " + partial + " " + base +
+					 ".cpp > " + base + ".log 2>&1";
+	if (system(command.c_str()) != 0 || rename(partial.c_str(), library.c_str()) != 0)
+	{
+		remove(partial.c_str());
+		why = "the compiler failed, see " + base + ".log";
+		return "";
+	}
+	return library;
+}
+
+shared_ptr<const NativeModel> NativeModel::load(const Model &model, string directory, string &why)
+{
+	string library = build(model, directory, why);
+	if (library == "")
+		return NULL;
+	// the code stays loaded as long as the process runs
+	void *handle = dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL);
+	if (handle == NULL)
+	{
+		why = dlerror();
+		return NULL;
+	}
+	const int *abi = (const int *)dlsym(handle, "smc_abi");
+	const int *count = (const int *)dlsym(handle, "smc_kernel_count");
+	Step const *steps = (Step const *)dlsym(handle, "smc_kernels");
+	if (abi == NULL || count == NULL || steps == NULL || *abi != ABI || *count != model.draws.size())
+	{
+		why = library + " is not a simulator of this model";
+		return NULL;
+	}
+	shared_ptr<NativeModel> native(new NativeModel());
+	native->library = library;
+	native->kernels.assign(steps, steps + *count);
+	return native;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include "Model.h"
+#include <memory>
+
+/**
+ * The steps of a DBN compiled to native code: the model is translated to a
+ * C++ translation unit, one straight-line function per kind of step with its
+ * constants inlined and its variables in the order of the schedule, built by
+ * the system compiler into a shared object and loaded with dlopen.
+ *
+ * The shared objects are cached in a directory under the hash of their
+ * source, so that the runs and the workers of the same model build it once.
+ * A step computes exactly what Sampler::Calculate() does for every variable,
+ * its normal draws are made before by the caller, in the runs of
+ * Model::noise.
+ */
+class NativeModel : private Tools
+{
+public:
+	// the entry points of the shared object, a fixed ABI: the values of the
+	// next step from the ones of this step and the normal draws of the step,
+	// all indexed by variable
+	typedef void (*Step)(const double *now, double *next, const double *noise);
+	static const int ABI = 1;
+
+	// the translation unit of model, empty with why when one of its
+	// operations cannot be compiled
+	static string source(const Model &model, string &why);
+	// builds the shared object of model in directory unless it is there,
+	// returns its path, empty with why on failure
+	static string build(const Model &model, string directory, string &why);
+	// build() and loads it, NULL with why on failure
+	static shared_ptr<const NativeModel> load(const Model &model, string directory, string &why);
+
+	string library; // path of the shared object
+	// the step of the kind of step kind, as in Model::kindAt()
+	Step kernel(int kind) const { return kernels[kind]; }
+
+private:
+	NativeModel() {}
+	vector<Step> kernels;
+};
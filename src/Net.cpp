@@ -0,0 +1,185 @@
+#include "Net.h"
+#include <iostream>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+Connection::Connection()
+{
+    fd = -1;
+}
+Connection::Connection(int f)
+{
+    fd = f;
+}
+
+// splits a TCP address into host ("" for any) and port
+static void splitAddress(string address, string &host, string &port)
+{
+    string::size_type pos = address.rfind(':');
+    if (pos == string::npos)
+    {
+        host = "";
+        port = address;
+    }
+    else
+    {
+        host = address.substr(0, pos);
+        port = address.substr(pos + 1);
+    }
+}
+static int unixSocket(string address, sockaddr_un &addr)
+{
+    string path = address.substr(5);
+    if (path.size() >= sizeof(addr.sun_path))
+    {
+        cerr << "Error: socket path too long: " << path << endl;
+        exit(EXIT_FAILURE);
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path.c_str());
+    return socket(AF_UNIX, SOCK_STREAM, 0);
+}
+int Connection::listenOn(string address)
+{
+    int s = -1;
+    if (address.compare(0, 5, "unix:") == 0)
+    {
+        sockaddr_un addr;
+        s = unixSocket(address, addr);
+        unlink(addr.sun_path);
+        if (s < 0 || bind(s, (sockaddr *)&addr, sizeof(addr)) != 0)
+            s = -1;
+    }
+    else
+    {
+        string host, port;
+        splitAddress(address, host, port);
+        addrinfo hints, *res;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_PASSIVE;
+        if (getaddrinfo(host == "" ? NULL : host.c_str(), port.c_str(), &hints, &res) == 0)
+        {
+            s = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+            int one = 1;
+            setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            if (s >= 0 && bind(s, res->ai_addr, res->ai_addrlen) != 0)
+                s = -1;
+            freeaddrinfo(res);
+        }
+    }
+    if (s < 0 || listen(s, 64) != 0)
+    {
+        cerr << "Error: cannot listen on " << address << endl;
+        exit(EXIT_FAILURE);
+    }
+    return s;
+}
+Connection Connection::connectTo(string address)
+{
+    for (int attempt = 0; attempt < 100; attempt++)
+    {
+        int s = -1;
+        if (address.compare(0, 5, "unix:") == 0)
+        {
+            sockaddr_un addr;
+            s = unixSocket(address, addr);
+            if (s >= 0 && connect(s, (sockaddr *)&addr, sizeof(addr)) == 0)
+                return Connection(s);
+        }
+        else
+        {
+            string host, port;
+            splitAddress(address, host, port);
+            addrinfo hints, *res;
+            memset(&hints, 0, sizeof(hints));
+            hints.ai_family = AF_INET;
+            hints.ai_socktype = SOCK_STREAM;
+            if (getaddrinfo(host == "" ? "localhost" : host.c_str(), port.c_str(), &hints, &res) == 0)
+            {
+                s = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+                bool ok = (s >= 0 && connect(s, res->ai_addr, res->ai_addrlen) == 0);
+                freeaddrinfo(res);
+                if (ok)
+                {
+                    int one = 1;
+                    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                    return Connection(s);
+                }
+            }
+        }
+        if (s >= 0)
+            ::close(s);
+        usleep(100000);
+    }
+    cerr << "Error: cannot connect to " << address << endl;
+    exit(EXIT_FAILURE);
+}
+Connection Connection::acceptFrom(int listenfd)
+{
+    int s = accept(listenfd, NULL, NULL);
+    if (s >= 0)
+    {
+        int one = 1;
+        setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return Connection(s);
+}
+bool Connection::fill()
+{
+    char buf[65536];
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n <= 0)
+        return false;
+    buffer.append(buf, n);
+    return true;
+}
+bool Connection::nextLine(string &line)
+{
+    string::size_type pos = buffer.find('\n');
+    if (pos == string::npos)
+        return false;
+    line = buffer.substr(0, pos);
+    buffer.erase(0, pos + 1);
+    return true;
+}
+bool Connection::readLine(string &line)
+{
+    while (!nextLine(line))
+    {
+        if (!fill())
+            return false;
+    }
+    return true;
+}
+bool Connection::writeLine(string line)
+{
+    line += "\n";
+    const char *p = line.c_str();
+    size_t left = line.size();
+    while (left > 0)
+    {
+        // MSG_NOSIGNAL: a worker that died must not kill the coordinator
+        ssize_t n = send(fd, p, left, MSG_NOSIGNAL);
+        if (n <= 0)
+            return false;
+        p += n;
+        left -= n;
+    }
+    return true;
+}
+void Connection::close()
+{
+    if (fd >= 0)
+        ::close(fd);
+    fd = -1;
+}
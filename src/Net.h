@@ -0,0 +1,43 @@
+#pragma once
+#include <string>
+using namespace std;
+
+/**
+ * A line oriented connection over a TCP or a Unix-domain socket, used
+ * between the coordinator and the workers of a distributed run.
+ *
+ * Addresses are "unix:<path>" for a Unix-domain socket, "<host>:<port>" or
+ * "<port>" for TCP. A coordinator listening on "<port>" accepts connections
+ * on every interface.
+ */
+class Connection
+{
+public:
+    int fd; // -1 when closed
+
+    Connection();
+    Connection(int fd);
+
+    // listening socket of a coordinator, exits on failure
+    static int listenOn(string address);
+    // connection of a worker to a coordinator, retried for a few seconds
+    // so that the workers can be started before the coordinator
+    static Connection connectTo(string address);
+    // accepts one pending connection on a listening socket
+    static Connection acceptFrom(int listenfd);
+
+    // reads what is available on the socket into the buffer, without
+    // blocking once poll() said it was readable, returns false at the end
+    // of the stream
+    bool fill();
+    // takes the next complete line of the buffer
+    bool nextLine(string &line);
+    // blocking read of the next line, returns false at the end of the stream
+    bool readLine(string &line);
+    // writes one line, returns false if the peer is gone
+    bool writeLine(string line);
+    void close();
+
+private:
+    string buffer; // received, not yet read
+};
@@ -0,0 +1,164 @@
+#include "Profiler.h"
+#include <atomic>
+#include <mutex>
+#include <iomanip>
+#include <time.h>
+
+const char *Profiler::phaseName[Profiler::NPHASES] = {"load", "parse", "simulate", "check", "check.build",
+                                                      "check.evaluate", "check.propagate", "save", "test"};
+bool Profiler::enabled = false;
+
+// the counters of one thread, only written by it
+struct ProfileSlot
+{
+    atomic<unsigned long> traces;
+    atomic<unsigned long> steps;
+    atomic<unsigned long> nanoseconds[Profiler::NPHASES];
+    atomic<unsigned long> calls[Profiler::NPHASES];
+
+    ProfileSlot() : traces(0), steps(0)
+    {
+        for (int p = 0; p < Profiler::NPHASES; p++)
+        {
+            nanoseconds[p].store(0);
+            calls[p].store(0);
+        }
+    }
+};
+
+// the slots outlive their threads, so that their counts are kept
+static mutex slotsMutex;
+static vector<ProfileSlot *> slots;
+
+static ProfileSlot &mySlot()
+{
+    thread_local ProfileSlot *slot = NULL;
+    if (slot == NULL)
+    {
+        slot = new ProfileSlot();
+        lock_guard<mutex> lock(slotsMutex);
+        slots.push_back(slot);
+    }
+    return *slot;
+}
+
+// the innermost scope open in the thread
+static thread_local ProfileScope *openScope = NULL;
+
+static inline void add(atomic<unsigned long> &c, unsigned long n)
+{
+    c.store(c.load(memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+double Profiler::now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+void Profiler::addTime(Phase p, double seconds, unsigned long calls)
+{
+    ProfileSlot &s = mySlot();
+    add(s.nanoseconds[p], (unsigned long)(seconds * 1e9));
+    add(s.calls[p], calls);
+}
+void Profiler::addTraces(unsigned long traces, unsigned long steps)
+{
+    ProfileSlot &s = mySlot();
+    add(s.traces, traces);
+    add(s.steps, steps);
+}
+static Profiler::Totals read(ProfileSlot &s)
+{
+    Profiler::Totals t;
+    t.traces = s.traces.load(memory_order_relaxed);
+    t.steps = s.steps.load(memory_order_relaxed);
+    for (int p = 0; p < Profiler::NPHASES; p++)
+    {
+        t.time[p] = s.nanoseconds[p].load(memory_order_relaxed) * 1e-9;
+        t.calls[p] = s.calls[p].load(memory_order_relaxed);
+    }
+    return t;
+}
+vector<Profiler::Totals> Profiler::threadTotals()
+{
+    vector<Totals> all;
+    lock_guard<mutex> lock(slotsMutex);
+    for (unsigned int i = 0; i < slots.size(); i++)
+        all.push_back(read(*slots[i]));
+    return all;
+}
+Profiler::Totals Profiler::totals()
+{
+    vector<Totals> all = threadTotals();
+    Totals t;
+    t.traces = 0;
+    t.steps = 0;
+    for (int p = 0; p < NPHASES; p++)
+    {
+        t.time[p] = 0;
+        t.calls[p] = 0;
+    }
+    for (unsigned int i = 0; i < all.size(); i++)
+    {
+        t.traces += all[i].traces;
+        t.steps += all[i].steps;
+        for (int p = 0; p < NPHASES; p++)
+        {
+            t.time[p] += all[i].time[p];
+            t.calls[p] += all[i].calls[p];
+        }
+    }
+    return t;
+}
+void Profiler::printSummary(ostream &out)
+{
+    vector<Totals> threads = threadTotals();
+    Totals t = totals();
+    double total = 0;
+    for (int p = 0; p < NPHASES; p++)
+        total += t.time[p];
+    ios::fmtflags flags = out.flags();
+    out << fixed;
+    out << "Profile: " << t.traces << " traces, " << t.steps << " steps, " << threads.size() << " threads" << endl;
+    out << setw(16) << left << "phase" << right << setw(14) << "calls" << setw(12) << "seconds" << setw(8) << "%"
+        << setw(14) << "us/call";
+    for (unsigned int i = 0; i < threads.size(); i++)
+        out << setw(10) << ("t" + to_string(i) + " s");
+    out << endl;
+    for (int p = 0; p < NPHASES; p++)
+    {
+        if (t.calls[p] == 0)
+            continue;
+        out << setw(16) << left << phaseName[p] << right << setw(14) << t.calls[p] << setw(12) << setprecision(3)
+            << t.time[p] << setw(8) << setprecision(1) << (total > 0 ? 100 * t.time[p] / total : 0) << setw(14)
+            << setprecision(3) << 1e6 * t.time[p] / t.calls[p];
+        for (unsigned int i = 0; i < threads.size(); i++)
+            out << setw(10) << setprecision(3) << threads[i].time[p];
+        out << endl;
+    }
+    out << setw(16) << left << "total" << right << setw(14) << "" << setw(12) << setprecision(3) << total << endl;
+    out.flags(flags);
+}
+
+ProfileScope::ProfileScope(Profiler::Phase p) : phase(p), on(Profiler::enabled), start(0), outer(NULL)
+{
+    if (!on)
+        return;
+    start = Profiler::now();
+    outer = openScope;
+    // the outer scope stops counting while this one is open
+    if (outer != NULL)
+        Profiler::addTime(outer->phase, start - outer->start);
+    openScope = this;
+}
+ProfileScope::~ProfileScope()
+{
+    if (!on)
+        return;
+    double end = Profiler::now();
+    Profiler::addTime(phase, end - start, 1);
+    openScope = outer;
+    if (outer != NULL)
+        outer->start = end;
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <ostream>
+using namespace std;
+
+/**
+ * Counters of the work done by all the threads of a run: traces, simulation
+ * steps and the time spent in every phase.
+ *
+ * Every thread adds to its own slot, so the counting does not synchronize
+ * the threads; totals() sums the slots and can be called while they run.
+ * Nothing is timed unless enabled is set (-profile true, -progress).
+ */
+class Profiler
+{
+public:
+    enum Phase
+    {
+        LOAD,            // loading the models and interventions
+        PARSE,           // parsing the properties
+        SIMULATE,        // generating the steps of the traces
+        CHECK,           // feeding the steps to the checkers
+        CHECK_BUILD,     // Checker::build_tree_list
+        CHECK_EVALUATE,  // Checker::evaluate, but its propagation
+        CHECK_PROPAGATE, // Checker::propagate
+        SAVE,            // writing the traces
+        TEST,            // evaluating the tests
+        NPHASES
+    };
+    static const char *phaseName[NPHASES];
+
+    struct Totals
+    {
+        unsigned long traces;
+        unsigned long steps;
+        double time[NPHASES];         // seconds, summed over the threads
+        unsigned long calls[NPHASES]; // timed scopes
+    };
+
+    static bool enabled;
+
+    // monotonic clock, in seconds
+    static double now();
+    static void addTime(Phase p, double seconds, unsigned long calls = 0);
+    // traces more, of steps steps in all
+    static void addTraces(unsigned long traces, unsigned long steps);
+    static Totals totals();
+    // the counters of every thread that counted something, in the order
+    // the threads started counting
+    static vector<Totals> threadTotals();
+    // table of the time per phase and per thread
+    static void printSummary(ostream &out);
+};
+
+// times the enclosing scope into one phase. The time of a scope opened
+// inside another one, in the same thread, only counts in the inner phase,
+// so the phases add up to the time measured.
+class ProfileScope
+{
+private:
+    Profiler::Phase phase;
+    bool on;
+    double start;
+    ProfileScope *outer;
+
+public:
+    ProfileScope(Profiler::Phase p);
+    ~ProfileScope();
+};
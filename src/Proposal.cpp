@@ -0,0 +1,86 @@
+#include "Proposal.h"
+#include <math.h>
+
+Proposal::Proposal(const Model &model)
+{
+	noisy.assign(model.variable_num, false);
+	beta.assign(model.variable_num, false);
+	shift.assign(model.variable_num, 0);
+	power.assign(model.variable_num, 1);
+	for (int k = 0; k < model.noise.size(); k++)
+	{
+		for (int r = 0; r < model.noise[k].size(); r++)
+			fill(noisy.begin() + model.noise[k][r].first, noisy.begin() + model.noise[k][r].first + model.noise[k][r].second, true);
+	}
+	for (int r = 0; r < model.betas.size(); r++)
+		fill(beta.begin() + model.betas[r].first, beta.begin() + model.betas[r].first + model.betas[r].second, true);
+}
+
+void Proposal::read(string file, const Model &model)
+{
+	ifstream in(file);
+	if (!in)
+		Tools::fail("Error: cannot open the proposal file " + file + ".");
+	string line;
+	while (getline(in, line))
+	{
+		istringstream is(line);
+		string name;
+		double value;
+		if (!(is >> name) || name[0] == '#')
+			continue;
+		if (!(is >> value) || model.variableIndex.count(name) == 0)
+			Tools::fail("Error: the proposal lines are \"<variable> <value>\": " + line);
+		int v = model.variableIndex.find(name)->second;
+		if (beta[v] && value > 0)
+			power[v] = value;
+		else if (noisy[v])
+			shift[v] = value;
+		else
+			Tools::fail("Error: " + name + " is neither a noisy variable nor a beta variable (of positive power).");
+	}
+}
+
+bool Proposal::nominal() const
+{
+	for (int v = 0; v < shift.size(); v++)
+	{
+		if (shift[v] != 0 || power[v] != 1)
+			return false;
+	}
+	return true;
+}
+
+double Proposal::tiltNormals(int first, int count, double *z) const
+{
+	// z + s is N(s, 1): the ratio of N(0, 1) to it is exp(s^2 / 2 - s (z + s))
+	double r = 0;
+	for (int i = 0; i < count; i++)
+	{
+		double s = shift[first + i];
+		z[i] += s;
+		r += s * s / 2 - s * z[i];
+	}
+	return r;
+}
+
+double Proposal::tiltUniform(int v, double &u) const
+{
+	// u^(1 / a) has density a u^(a - 1)
+	double a = power[v];
+	if (a == 1)
+		return 0;
+	u = pow(u, 1 / a);
+	return -log(a) - (a - 1) * log(u);
+}
+
+void Proposal::print(ostream &out, const Model &model) const
+{
+	for (int v = 0; v < shift.size(); v++)
+	{
+		if (shift[v] != 0)
+			out << model.cpd_order[v] << " " << shift[v] << endl;
+		else if (power[v] != 1)
+			out << model.cpd_order[v] << " " << power[v] << endl;
+	}
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include "Model.h"
+
+/**
+ * Proposal of importance sampling for the traces of a DBN: the normal draw
+ * of a noisy variable is shifted by shift[v] standard deviations, at every
+ * step, and the uniform draw that picks the histogram bin of a beta
+ * variable follows the density a u^(a - 1) on (0, 1), a = power[v], rather
+ * than the uniform one; a > 1 favours its upper bins. Both families contain
+ * the nominal model, shift 0 and power 1, and have the closed-form
+ * likelihood ratios and cross-entropy updates of an exponential family.
+ */
+class Proposal
+{
+public:
+	// the nominal model: no variable tilted
+	Proposal(const Model &model);
+
+	vector<bool> noisy, beta; // the variables that draw normal noise, the beta variables
+	vector<double> shift, power;
+
+	// reads the "<variable> <value>" lines of file, the shift of a noisy
+	// variable or the power of a beta variable; fails on anything else
+	void read(string file, const Model &model);
+	bool nominal() const;
+
+	// tilts the standard normal draws z of the count variables from first
+	// on, returns the log of the likelihood ratio of the nominal draws to them
+	double tiltNormals(int first, int count, double *z) const;
+	// the same for the uniform draw 0 u of beta variable v
+	double tiltUniform(int v, double &u) const;
+
+	void print(ostream &out, const Model &model) const;
+};
@@ -0,0 +1,320 @@
+#include "RandomStream.h"
+#include "Sobol.h"
+#include <cmath>
+
+uint64_t RandomStream::seed = 0;
+unsigned RandomStream::randomizations = 0;
+bool RandomStream::antithetic = false;
+
+RandomStream::RandomStream()
+{
+	trace = 0;
+	counter = 0;
+}
+RandomStream::RandomStream(uint64_t t)
+{
+	trace = t;
+	counter = 0;
+}
+void RandomStream::setSeed(uint64_t s)
+{
+	seed = s;
+}
+uint64_t RandomStream::getSeed()
+{
+	return seed;
+}
+void RandomStream::setRandomizations(unsigned r)
+{
+	randomizations = r;
+}
+unsigned RandomStream::getRandomizations()
+{
+	return randomizations;
+}
+void RandomStream::setAntithetic(bool a)
+{
+	antithetic = a;
+}
+bool RandomStream::getAntithetic()
+{
+	return antithetic;
+}
+void RandomStream::setTrace(uint64_t t)
+{
+	trace = t;
+	counter = 0;
+}
+uint64_t RandomStream::getTrace()
+{
+	return trace;
+}
+
+static inline void mulhilo(uint32_t a, uint32_t b, uint32_t &hi, uint32_t &lo)
+{
+	uint64_t p = (uint64_t)a * b;
+	hi = (uint32_t)(p >> 32);
+	lo = (uint32_t)p;
+}
+/**
+ * one Philox4x32-10 block turned into two doubles: two uniforms in (0, 1) for
+ * kind 0, two independent N(0, 1) by Box-Muller for kind 1
+ */
+void RandomStream::block(uint32_t pair, uint32_t step, uint32_t kind, uint32_t draw, double out[2])
+{
+	uint32_t c0 = (uint32_t)trace, c1 = (uint32_t)(trace >> 32), c2 = step;
+	uint32_t c3 = (pair & 0x07FFFFFF) | (kind << 27) | ((draw & 0xF) << 28);
+	uint32_t k0 = (uint32_t)seed, k1 = (uint32_t)(seed >> 32);
+	for (int r = 0; r < 10; r++)
+	{
+		uint32_t hi0, lo0, hi1, lo1;
+		mulhilo(0xD2511F53, c0, hi0, lo0);
+		mulhilo(0xCD9E8D57, c2, hi1, lo1);
+		c0 = hi1 ^ c1 ^ k0;
+		c1 = lo1;
+		c2 = hi0 ^ c3 ^ k1;
+		c3 = lo0;
+		k0 += 0x9E3779B9;
+		k1 += 0xBB67AE85;
+	}
+	// 53 random bits each, shifted by half an ulp so that 0 and 1 never occur
+	double u0 = ((double)((((uint64_t)c0 << 32) | c1) >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+	double u1 = ((double)((((uint64_t)c2 << 32) | c3) >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+	if (kind == 0)
+	{
+		out[0] = u0;
+		out[1] = u1;
+	}
+	else
+	{
+		double r = sqrt(-2 * log(u0));
+		double a = 2 * M_PI * u1;
+		out[0] = r * cos(a);
+		out[1] = r * sin(a);
+	}
+}
+/**
+ * the Sobol coordinate of a key, -1 if it has none: the draws 0 and 1 of step
+ * 0 (the beta variables) and the draws 0 of the next steps, as rows k = 0, 1,
+ * step + 1 of a table enumerated by its antidiagonals k + variable, so that
+ * the first coordinates go to the first steps and variables
+ */
+int RandomStream::dimension(uint32_t variable, uint32_t step, uint32_t draw)
+{
+	if (randomizations == 0 || (step == 0 ? draw > 1 : draw != 0))
+		return -1;
+	uint64_t k = step == 0 ? draw : (uint64_t)step + 1;
+	uint64_t diagonal = k + variable;
+	uint64_t d = diagonal * (diagonal + 1) / 2 + variable;
+	return d < Sobol::DIMENSIONS ? (int)d : -1;
+}
+double RandomStream::sobol(int dimension)
+{
+	uint64_t r = trace % randomizations;
+	uint64_t scramble = seed ^ (r * 0x9E3779B97F4A7C15ULL) ^ ((uint64_t)dimension << 48);
+	return Sobol::point((uint32_t)(trace / randomizations), dimension, scramble);
+}
+// Acklam's rational approximation, refined by a step of Halley's method
+static double inverseNormal(double p)
+{
+	static const double a[] = {-3.969683028665376e+01, 2.209460984245205e+02, -2.759285104469687e+02,
+							   1.383577518672690e+02, -3.066479806614716e+01, 2.506628277459239e+00};
+	static const double b[] = {-5.447609879822406e+01, 1.615858368580409e+02, -1.556989798598866e+02,
+							   6.680131188771972e+01, -1.328068155288572e+01};
+	static const double c[] = {-7.784894002430293e-03, -3.223964580411365e-01, -2.400758277161838e+00,
+							   -2.549732539343734e+00, 4.374664141464968e+00, 2.938163982698783e+00};
+	static const double d[] = {7.784695709041462e-03, 3.224671290700398e-01, 2.445134137142996e+00,
+							   3.754408661907416e+00};
+	double x;
+	if (p < 0.02425 || p > 1 - 0.02425)
+	{
+		double q = sqrt(-2 * log(p < 0.5 ? p : 1 - p));
+		x = (((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5]) /
+			((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1);
+		if (p > 0.5)
+			x = -x;
+	}
+	else
+	{
+		double q = p - 0.5, r = q * q;
+		x = (((((a[0] * r + a[1]) * r + a[2]) * r + a[3]) * r + a[4]) * r + a[5]) * q /
+			(((((b[0] * r + b[1]) * r + b[2]) * r + b[3]) * r + b[4]) * r + 1);
+	}
+	double e = 0.5 * erfc(-x / sqrt(2.0)) - p;
+	double u = e * sqrt(2 * M_PI) * exp(x * x / 2);
+	return x - u / (1 + x * u / 2);
+}
+double RandomStream::uniform(uint32_t variable, uint32_t step, uint32_t draw)
+{
+	if (antithetic && (trace & 1))
+		return 1 - RandomStream(trace - 1).uniform(variable, step, draw);
+	int d = dimension(variable, step, draw);
+	if (d >= 0)
+		return sobol(d);
+	double b[2];
+	block(variable >> 1, step, 0, draw, b);
+	return b[variable & 1];
+}
+double RandomStream::normal(uint32_t variable, uint32_t step, uint32_t draw)
+{
+	if (antithetic && (trace & 1))
+		return -RandomStream(trace - 1).normal(variable, step, draw);
+	int d = dimension(variable, step, draw);
+	if (d >= 0)
+		return inverseNormal(sobol(d));
+	double b[2];
+	block(variable >> 1, step, 1, draw, b);
+	return b[variable & 1];
+}
+/**
+ * the rounds of block() for w <= TILE blocks side by side, their counters in
+ * c0 .. c3 replaced by their outputs, in loops the compiler vectorizes
+ */
+static const int TILE = 16;
+static void rounds(int w, uint32_t *c0, uint32_t *c1, uint32_t *c2, uint32_t *c3, uint64_t seed)
+{
+	uint32_t k0 = (uint32_t)seed, k1 = (uint32_t)(seed >> 32);
+	for (int r = 0; r < 10; r++)
+	{
+		for (int i = 0; i < w; i++)
+		{
+			uint64_t p0 = (uint64_t)0xD2511F53 * c0[i];
+			uint64_t p1 = (uint64_t)0xCD9E8D57 * c2[i];
+			c0[i] = (uint32_t)(p1 >> 32) ^ c1[i] ^ k0;
+			c1[i] = (uint32_t)p1;
+			c2[i] = (uint32_t)(p0 >> 32) ^ c3[i] ^ k1;
+			c3[i] = (uint32_t)p0;
+		}
+		k0 += 0x9E3779B9;
+		k1 += 0xBB67AE85;
+	}
+}
+/**
+ * the blocks of kind of the pairs first .. first + pairs - 1 of this trace at
+ * step, tile by tile: out[2 * i] and out[2 * i + 1] are the draws of pair
+ * first + i
+ */
+void RandomStream::blocks(uint32_t first, int pairs, uint32_t step, uint32_t kind, uint32_t draw, double *out)
+{
+	uint32_t c0[TILE], c1[TILE], c2[TILE], c3[TILE];
+	for (int base = 0; base < pairs; base += TILE)
+	{
+		int w = pairs - base < TILE ? pairs - base : TILE;
+		for (int i = 0; i < w; i++)
+		{
+			c0[i] = (uint32_t)trace;
+			c1[i] = (uint32_t)(trace >> 32);
+			c2[i] = step;
+			c3[i] = ((first + base + i) & 0x07FFFFFF) | (kind << 27) | ((draw & 0xF) << 28);
+		}
+		rounds(w, c0, c1, c2, c3, seed);
+		double *o = out + 2 * base;
+		for (int i = 0; i < w; i++)
+		{
+			o[2 * i] = ((double)((((uint64_t)c0[i] << 32) | c1[i]) >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+			o[2 * i + 1] = ((double)((((uint64_t)c2[i] << 32) | c3[i]) >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+		}
+		for (int i = 0; i < w && kind == 1; i++)
+		{
+			double r = sqrt(-2 * log(o[2 * i]));
+			double a = 2 * M_PI * o[2 * i + 1];
+			o[2 * i] = r * cos(a);
+			o[2 * i + 1] = r * sin(a);
+		}
+	}
+}
+/**
+ * draws of kind for the n variables from variable on: the whole pairs go
+ * to blocks(), the odd ends one block each
+ */
+void RandomStream::draws(uint32_t variable, uint32_t step, int n, uint32_t kind, uint32_t draw, double *out)
+{
+	if (antithetic && (trace & 1))
+	{
+		RandomStream(trace - 1).draws(variable, step, n, kind, draw, out);
+		for (int i = 0; i < n; i++)
+			out[i] = kind == 0 ? 1 - out[i] : -out[i];
+		return;
+	}
+	if (randomizations != 0)
+	{
+		for (int i = 0; i < n; i++)
+			out[i] = kind == 0 ? uniform(variable + i, step, draw) : normal(variable + i, step, draw);
+		return;
+	}
+	double b[2];
+	int i = 0;
+	if (n > 0 && (variable & 1))
+	{
+		block(variable >> 1, step, kind, draw, b);
+		out[i++] = b[1];
+	}
+	int pairs = (n - i) / 2;
+	blocks((variable + i) >> 1, pairs, step, kind, draw, out + i);
+	i += 2 * pairs;
+	if (i < n)
+	{
+		block((variable + i) >> 1, step, kind, draw, b);
+		out[i] = b[0];
+	}
+}
+void RandomStream::uniforms(uint32_t variable, uint32_t step, int n, double *out, uint32_t draw)
+{
+	draws(variable, step, n, 0, draw, out);
+}
+void RandomStream::normals(uint32_t variable, uint32_t step, int n, double *out, uint32_t draw)
+{
+	draws(variable, step, n, 1, draw, out);
+}
+void RandomStream::normalLanes(uint64_t first, int n, uint32_t pair, uint32_t step, double *out, uint32_t draw)
+{
+	if (randomizations != 0 || antithetic)
+	{
+		for (int i = 0; i < n; i++)
+		{
+			RandomStream lane(first + i);
+			out[i] = lane.normal(2 * pair, step, draw);
+			out[n + i] = lane.normal(2 * pair + 1, step, draw);
+		}
+		return;
+	}
+	uint32_t c0[TILE], c1[TILE], c2[TILE], c3[TILE];
+	for (int base = 0; base < n; base += TILE)
+	{
+		int w = n - base < TILE ? n - base : TILE;
+		for (int i = 0; i < w; i++)
+		{
+			uint64_t t = first + base + i;
+			c0[i] = (uint32_t)t;
+			c1[i] = (uint32_t)(t >> 32);
+			c2[i] = step;
+			c3[i] = (pair & 0x07FFFFFF) | (1u << 27) | ((draw & 0xF) << 28);
+		}
+		rounds(w, c0, c1, c2, c3, seed);
+		for (int i = 0; i < w; i++)
+		{
+			double u0 = ((double)((((uint64_t)c0[i] << 32) | c1[i]) >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+			double u1 = ((double)((((uint64_t)c2[i] << 32) | c3[i]) >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+			double r = sqrt(-2 * log(u0));
+			double a = 2 * M_PI * u1;
+			out[base + i] = r * cos(a);
+			out[n + base + i] = r * sin(a);
+		}
+	}
+}
+// the sequential draws use the keys no sampler ever uses: the last steps,
+// pseudo-random in every mode
+double RandomStream::uniform()
+{
+	uint64_t c = counter++;
+	double b[2];
+	block((uint32_t)(c & 0x0FFFFFFF) >> 1, 0xFFFFFFFF - (uint32_t)(c >> 28), 0, 0, b);
+	return b[c & 1];
+}
+double RandomStream::normal()
+{
+	uint64_t c = counter++;
+	double b[2];
+	block((uint32_t)(c & 0x0FFFFFFF) >> 1, 0xFFFFFFFF - (uint32_t)(c >> 28), 1, 0, b);
+	return b[c & 1];
+}
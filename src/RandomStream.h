@@ -0,0 +1,75 @@
+#pragma once
+#include <stdint.h>
+
+/**
+ * Counter-based random numbers (Philox4x32-10, Salmon et al., SC 2011).
+ *
+ * A keyed draw is a pure function of (seed, trace, variable, step, draw): it
+ * does not depend on which thread produced the trace nor on the order in
+ * which traces were produced, so a run is reproducible from its seed whatever
+ * the number of threads. The stream itself only holds the trace index and a
+ * counter for the draws that have no natural key.
+ *
+ * Consecutive variables share a Philox block, so the batched draws of n
+ * consecutive variables cost n/2 blocks and return exactly what the single
+ * draws would. Their blocks are computed in tiles, the rounds of a tile side
+ * by side in loops the compiler vectorizes, then turned into doubles.
+ *
+ * With randomizations (-sampling qmc), the keyed draws of the first steps
+ * are instead the coordinates of a scrambled Sobol sequence: trace t is
+ * point t / randomizations of randomization t % randomizations, see
+ * dimension() for the coordinate of a key. The normal draws are then the
+ * inverse normal CDF of the coordinates, and the keys without a coordinate
+ * keep their Philox draws.
+ *
+ * With antithetic pairs (-antithetic true), an odd trace draws the mirror of
+ * the trace before it: the keyed uniforms u of trace 2i + 1 are the 1 - u of
+ * trace 2i and its normals their opposites.
+ */
+class RandomStream
+{
+public:
+	RandomStream();
+	RandomStream(uint64_t trace);
+
+	// global seed shared by all streams, set once from -seed
+	static void setSeed(uint64_t s);
+	static uint64_t getSeed();
+	// independent scrambles of the Sobol sequence, 0 (the default) for
+	// pseudo-random draws only
+	static void setRandomizations(unsigned r);
+	static unsigned getRandomizations();
+	static void setAntithetic(bool a);
+	static bool getAntithetic();
+
+	void setTrace(uint64_t t);
+	uint64_t getTrace();
+
+	// keyed draws; draw (< 16) tells apart several draws of the same key
+	double uniform(uint32_t variable, uint32_t step, uint32_t draw = 0); // in (0, 1)
+	double normal(uint32_t variable, uint32_t step, uint32_t draw = 0);  // N(0, 1)
+	// out[i] = uniform(variable + i, step, draw), resp. normal(...)
+	void uniforms(uint32_t variable, uint32_t step, int n, double *out, uint32_t draw = 0);
+	void normals(uint32_t variable, uint32_t step, int n, double *out, uint32_t draw = 0);
+	// the normal draws of the pair of variables 2 * pair and 2 * pair + 1 for
+	// n consecutive traces: out[i] = RandomStream(first + i).normal(2 * pair,
+	// step, draw) and out[n + i] the one of 2 * pair + 1. The blocks of the
+	// traces are computed side by side, in loops the compiler vectorizes.
+	static void normalLanes(uint64_t first, int n, uint32_t pair, uint32_t step, double *out, uint32_t draw = 0);
+
+	// sequential draws, for callers that have no key
+	double uniform();
+	double normal();
+
+private:
+	static uint64_t seed;
+	static unsigned randomizations;
+	static bool antithetic;
+	uint64_t trace;
+	uint64_t counter;
+	void block(uint32_t pair, uint32_t step, uint32_t kind, uint32_t draw, double out[2]);
+	void blocks(uint32_t first, int pairs, uint32_t step, uint32_t kind, uint32_t draw, double *out);
+	void draws(uint32_t variable, uint32_t step, int n, uint32_t kind, uint32_t draw, double *out);
+	static int dimension(uint32_t variable, uint32_t step, uint32_t draw);
+	double sobol(int dimension);
+};
@@ -50,6 +50,7 @@ where:
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <iomanip>
 #include <vector>
 #include <string>
 #include <algorithm>
@@ -70,11 +71,24 @@ where:
 #include <unistd.h>
 #include <dirent.h>
 #include <stdio.h>
+#include <atomic>
+#include <sched.h>
+#include <poll.h>
+#include <errno.h>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
 #include "Tools.h"
 #include "ModelSearch.h"
 #include <map>
 #include"BooleanNet.hpp"
 #include "interface.hpp"
+#include "RandomStream.h"
+#include "Net.h"
+#include "Profiler.h"
+#include "LinearGaussian.h"
+#include "Splitting.h"
+#include "NativeModel.h"
 using std::cerr;
 using std::cout;
 using std::endl;
@@ -90,6 +104,243 @@ using namespace std;
 // base class for every statistical test
 
 double tempResult;
+bool asyncMode = false; // -async true: workers never wait for each other
+unsigned int batchSize = 1; // -batchsize <K>: traces per thread and per round without -async
+unsigned int lanes = 1;     // -lanes <W>: traces a thread draws side by side
+// -sampling qmc: the traces and successes of every randomization of the
+// Sobol sequence, trace t in randomization t % R
+struct Randomizations
+{
+    vector<unsigned long int> n, x;
+
+    Randomizations() : n(RandomStream::getRandomizations(), 0), x(RandomStream::getRandomizations(), 0)
+    {
+    }
+
+    void add(unsigned long int trace, int r)
+    {
+        if (n.empty())
+            return;
+        n[trace % n.size()] += 1;
+        x[trace % n.size()] += r;
+    }
+
+    // whether they hold all the samples, the first total of them
+    bool holds(unsigned long int total) const
+    {
+        unsigned long int sum = 0;
+        for (unsigned int i = 0; i < n.size(); i++)
+            sum += n[i];
+        return sum == total;
+    }
+};
+// -antithetic true, -control <variable>[<step>]: the estimation tests are
+// decided on variance-reduced observations rather than on the counts. An
+// observation is the result y of a trace or, with antithetic pairs, the mean
+// of the results of traces 2i and 2i + 1; with a control variate it comes
+// with the control value g of its traces, of known mean mu, and the estimate
+// is corrected by the regression of y on g. With -stratify, the results are
+// counted per stratum and the estimate is the mean of the strata weighted by
+// their prior masses. With -proposal, an observation is the result of a
+// trace times its likelihood ratio w, nominal over proposal, and the
+// successes count by their effective number (sum w)^2 / sum w^2.
+class Observations
+{
+private:
+    bool pairs, controlled, importance, neyman;
+    double mu, muVariance; // the mean of the control and its variance, when it is estimated
+    unsigned long int m;     // observations
+    double my, mg;           // their means
+    double cyy, cgg, cyg;    // and their centered sums of squares and products
+    long long pending;       // first trace of a pair not complete yet, -1 if none
+    double pendingY, pendingG;
+    vector<double> weights;  // of the strata, empty if not stratified
+    vector<unsigned long int> sn, sx; // results and successes per stratum
+    double sw, sw2;          // sums of the likelihood ratios of the successes and of their squares
+
+public:
+    Observations(bool pairs = false, bool controlled = false, double mu = 0, double muVariance = 0,
+                 const vector<double> &weights = vector<double>(), bool neyman = false, bool importance = false)
+        : pairs(pairs), controlled(controlled), importance(importance), neyman(neyman), mu(mu),
+          muVariance(muVariance), m(0), my(0), mg(0), cyy(0), cgg(0), cyg(0), pending(-1), pendingY(0), pendingG(0),
+          weights(weights), sn(weights.size(), 0), sx(weights.size(), 0), sw(0), sw2(0)
+    {
+    }
+
+    bool on() const
+    {
+        return pairs || controlled || !weights.empty() || importance;
+    }
+
+    // whether the traces are drawn from the prior with equal weights, so
+    // that the counts of their results decide the tests as well: not with a
+    // proposal nor with the strata of -allocation neyman
+    bool nominal() const
+    {
+        return !importance && !neyman;
+    }
+
+    // whether the normal interval of n samples with x successes stands on
+    // its own: 10 successes and failures, and 10 effective successes with a
+    // proposal, whose failures weigh nothing. The strata of -allocation
+    // neyman always do, their variances are not 0 even when all the results
+    // agree. Fails when 1000 successes of the proposal are not worth 10: its
+    // likelihood ratios are too uneven for the tests to ever decide
+    bool normal(unsigned long int n, unsigned long int x) const
+    {
+        if (importance && x >= 1000 && successes(x) < 10)
+        {
+            ostringstream os;
+            os << "Error: the " << x << " successes of the proposal are worth " << setprecision(3) << successes(x)
+               << " of the nominal distribution, their likelihood ratios are too uneven; choose a closer proposal.";
+            Tools::fail(os.str());
+        }
+        if (importance)
+            return successes(x) >= 10;
+        return neyman || (x >= 10 && n - x >= 10);
+    }
+
+    // the result r of trace, its control value g, its stratum and its
+    // likelihood ratio w
+    void add(unsigned long int trace, int r, double g, int stratum = -1, double w = 1)
+    {
+        if (!weights.empty())
+        {
+            m++;
+            sn[stratum]++;
+            sx[stratum] += r;
+            return;
+        }
+        double y = r;
+        if (importance)
+        {
+            y = w * r;
+            sw += w * r;
+            sw2 += w * w * r;
+        }
+        if (pairs && trace % 2 == 0)
+        {
+            pending = trace;
+            pendingY = y;
+            pendingG = g;
+            return;
+        }
+        if (pairs)
+        {
+            // the first trace of the pair was not checked
+            if (pending != (long long)trace - 1)
+                return;
+            y = (pendingY + y) / 2;
+            g = (pendingG + g) / 2;
+            pending = -1;
+        }
+        m++;
+        double dy = y - my, dg = g - mg;
+        my += dy / m;
+        mg += dg / m;
+        cyy += dy * (y - my);
+        cgg += dg * (g - mg);
+        cyg += dy * (g - mg);
+    }
+
+    unsigned long int count() const
+    {
+        return m;
+    }
+
+    // the effective number of the x successes
+    double successes(unsigned long int x) const
+    {
+        if (!importance)
+            return x;
+        return sw2 > 0 ? sw * sw / sw2 : 0;
+    }
+
+    double estimate() const
+    {
+        if (!weights.empty())
+        {
+            double e = 0;
+            for (unsigned int h = 0; h < weights.size(); h++)
+                e += sn[h] == 0 ? 0 : weights[h] * sx[h] / sn[h];
+            return e;
+        }
+        double e = my;
+        if (controlled && cgg > 0)
+            e -= cyg / cgg * (mg - mu);
+        return min(1.0, max(0.0, e));
+    }
+
+    // of the normal interval of coverage c of estimate(), -1 before 3
+    // observations, or 2 in every stratum; the variance of a stratum is
+    // taken at (x + 1) / (n + 2), not 0 when all its results agree. With a
+    // control, the error of mu adds through the slope of the regression
+    double halfWidth(double c) const
+    {
+        if (!weights.empty())
+        {
+            double var = 0;
+            for (unsigned int h = 0; h < weights.size(); h++)
+            {
+                if (sn[h] < 2)
+                    return -1;
+                double p = (sx[h] + 1.0) / (sn[h] + 2.0);
+                var += weights[h] * weights[h] * p * (1 - p) / sn[h];
+            }
+            return gsl_cdf_ugaussian_Pinv((1 + c) / 2) * sqrt(var);
+        }
+        if (m < 3)
+            return -1;
+        double var = cyy / (m - 1) / m;
+        if (controlled && cgg > 0)
+            var = max(0.0, cyy - cyg * cyg / cgg) / (m - 2) / m + cyg / cgg * cyg / cgg * muVariance;
+        return gsl_cdf_ugaussian_Pinv((1 + c) / 2) * sqrt(var);
+    }
+
+    // the part of halfWidth(c) that the error of mu alone gives, which more
+    // observations do not reduce
+    double muHalfWidth(double c) const
+    {
+        if (!controlled || cgg <= 0)
+            return 0;
+        return gsl_cdf_ugaussian_Pinv((1 + c) / 2) * fabs(cyg / cgg) * sqrt(muVariance);
+    }
+
+    string name() const
+    {
+        if (!weights.empty())
+            return "stratified, " + to_string(weights.size()) + " strata";
+        if (importance)
+        {
+            ostringstream os;
+            os << "importance sampling, " << setprecision(4) << successes(0) << " effective successes";
+            return os.str();
+        }
+        return pairs && controlled ? "antithetic pairs, control variate" : pairs ? "antithetic pairs" : "control variate";
+    }
+
+    void save(ostream &os) const
+    {
+        os << m << " " << setprecision(17) << my << " " << mg << " " << cyy << " " << cgg << " " << cyg << " " << pending
+           << " " << pendingY << " " << pendingG << " " << sn.size();
+        for (unsigned int h = 0; h < sn.size(); h++)
+            os << " " << sn[h] << " " << sx[h];
+        os << " " << sw << " " << sw2;
+    }
+
+    void load(istream &is)
+    {
+        is >> m >> my >> mg >> cyy >> cgg >> cyg >> pending >> pendingY >> pendingG;
+        unsigned int strata = 0;
+        if (is >> strata && strata == sn.size())
+        {
+            for (unsigned int h = 0; h < strata; h++)
+                is >> sn[h] >> sx[h];
+        }
+        if (!(is >> sw >> sw2))
+            sw = sw2 = 0;
+    }
+};
 class Test
 {
 protected:
@@ -118,6 +369,52 @@ public:
     virtual void doTest(unsigned long int n, unsigned long int x) = 0;
 
     virtual void printResult() = 0;
+
+    // state of the test for the checkpoints: doTest only depends on (n, x),
+    // so the outcome is all there is to keep
+    virtual void save(ostream &os)
+    {
+        os << out << " " << samples << " " << successes;
+    }
+
+    virtual void load(istream &is)
+    {
+        is >> out >> samples >> successes;
+    }
+
+    string getArgs()
+    {
+        return args;
+    }
+
+    // samples and successes the test was decided on
+    unsigned long int getSamples()
+    {
+        return samples;
+    }
+
+    unsigned long int getSuccesses()
+    {
+        return successes;
+    }
+
+    // estimate on n samples with x successes, for the progress reports
+    virtual double runningEstimate(unsigned long int n, unsigned long int x)
+    {
+        return (n == 0) ? 0 : double(x) / double(n);
+    }
+
+    // samples still needed by a fixed-size test, -1 for a sequential one
+    virtual long remaining(unsigned long int n)
+    {
+        return -1;
+    }
+
+    // the hypothesis accepted by a finished hypothesis test, "" for an estimation
+    virtual string verdict()
+    {
+        return "";
+    }
 };
 
 // base class for hypothesis tests
@@ -126,18 +423,83 @@ class HTest : public Test
 protected:
     double theta; // threshold
                   // Null hypothesis is (theta, 1)
+    // -proposal, -allocation neyman: the weighted estimate and the half-width
+    // of its interval the test was decided on, -1 when decided on the counts
+    double weightedEstimate, weightedHalfWidth;
+    string reduction;
 
 public:
     static const unsigned int NULLHYP = 2;
     static const unsigned int ALTHYP = 1;
 
-    HTest(string v) : Test(v), theta(0.0)
+    HTest(string v) : Test(v), theta(0.0), weightedEstimate(0.0), weightedHalfWidth(-1)
     {
     }
     double getEstimate()
     {
         return 0;
     }
+
+    // the error of the decisions on weighted observations, their interval
+    // covers 1 - level
+    virtual double level()
+    {
+        return 0.01;
+    }
+
+    // estimates this far from theta may take either hypothesis
+    virtual double indifference()
+    {
+        return 0;
+    }
+
+    // the decision on the observations o of n samples with x successes that
+    // are not nominal, with the guards of Estim::doReducedTest: the
+    // hypothesis on the side of theta of the whole interval of coverage
+    // 1 - level(), or the side of the estimate once the interval is within
+    // the indifference region. The interval is looked at after every sample
+    // from 100 on, and those repeated looks at a fixed coverage do not keep
+    // the error of the decision under level() as SPRT and BFT do on the
+    // counts: it is an approximation, all the better as level() is small
+    void doReducedTest(const Observations &o, unsigned long int n, unsigned long int x)
+    {
+        double h = o.halfWidth(1 - level());
+        if (o.count() < 100 || h < 0 || !o.normal(n, x))
+            return;
+        double e = o.estimate();
+        unsigned int decision;
+        if (e - h >= theta || (h <= indifference() && e >= theta))
+            decision = NULLHYP;
+        else if (e + h < theta || h <= indifference())
+            decision = ALTHYP;
+        else
+            return;
+        out = decision;
+        samples = n;
+        successes = x;
+        weightedEstimate = e;
+        weightedHalfWidth = h;
+        reduction = o.name();
+    }
+
+    void save(ostream &os)
+    {
+        Test::save(os);
+        os << " " << setprecision(17) << weightedEstimate << " " << weightedHalfWidth << " " << reduction;
+    }
+
+    void load(istream &is)
+    {
+        Test::load(is);
+        // the checkpoints of the runs before the weighted decisions end here
+        if (!(is >> weightedEstimate >> weightedHalfWidth))
+            weightedHalfWidth = -1;
+        getline(is >> ws, reduction);
+    }
+    string verdict()
+    {
+        return (out == NULLHYP) ? "null" : (out == ALTHYP) ? "alternative" : "";
+    }
     void printResult()
     {
 
@@ -156,7 +518,11 @@ public:
                  << "Reject Null hypothesis";
             break;
         }
-        cout << ", successes = " << successes << ", samples = " << samples << endl;
+        cout << ", successes = " << successes << ", samples = " << samples;
+        if (weightedHalfWidth >= 0)
+            cout << ", estimate = " << weightedEstimate << " +- " << weightedHalfWidth << " ("
+                 << (1 - level()) * 100 << "%, " << reduction << ")";
+        cout << endl;
     }
 };
 
@@ -167,15 +533,180 @@ protected:
     double delta;    // half-interval width
     double c;        // coverage probability
     double estimate; // the estimate
+    // -sampling qmc: the mean of the estimates of the randomizations and the
+    // half-width of its Student interval, when the test was decided on them
+    unsigned int randomizations;
+    double randomizedEstimate, halfWidth;
+    // -antithetic, -control: the half-width of the interval of the
+    // variance-reduced estimate, -1 when decided on the counts
+    double reducedHalfWidth;
+    string reduction;
 
 public:
-    Estim(string v) : Test(v), delta(0.0), c(0.0), estimate(0.0)
+    Estim(string v)
+        : Test(v), delta(0.0), c(0.0), estimate(0.0), randomizations(0), randomizedEstimate(0.0), halfWidth(0.0),
+          reducedHalfWidth(-1)
+    {
+    }
+
+    // the decision on the variance-reduced observations o of n samples with
+    // x successes: at least 100 of them and an interval of coverage c of
+    // half-width delta at most, once o.normal(). Short of the successes or
+    // failures, p near 0 or 1, the interval also waits for doTest to stop on
+    // the counts: its variance may be 0 on a few observations that all
+    // agree; not with a proposal, which goes on sampling, nor the Neyman
+    // strata: their counts are not of p. CHB too only stops at its bound N
+    // with the interval within delta: N is for N independent results in
+    // [0, 1], which the pairs, the results corrected by the control or
+    // weighted by the proposal and the Neyman strata are not
+    virtual void doReducedTest(const Observations &o, unsigned long int n, unsigned long int x)
+    {
+        double h = o.halfWidth(coverage());
+        if (o.count() >= 100 && o.muHalfWidth(coverage()) > delta)
+            Tools::fail("Error: the error of the mean of the control variate alone makes the half-width exceed " +
+                        to_string(delta) + "; raise -exactdraws.");
+        if (o.count() < 100 || h < 0 || h > delta)
+            return;
+        if (!o.normal(n, x))
+        {
+            if (!o.nominal())
+                return;
+            doTest(n, x);
+            if (!done())
+                return;
+        }
+        decide(o, n, x);
+    }
+
+    // -sampling qmc: the decision on the R randomizations of n samples with
+    // x successes, under the guards of doReducedTest: at least 100 samples,
+    // all the randomizations drawn and the Student interval of their
+    // estimates of half-width delta at most. The interval is only looked at
+    // when every randomization has 2^k points, where the Sobol points are
+    // balanced, and look j of them spends 1 / 2^j of the error 1 - c: its
+    // interval has coverage 1 - (1 - c) / 2^j, so that the one the test
+    // stops on still covers p with probability c, however small the
+    // variance of R - 1 degrees of freedom comes out at some look. The
+    // traces of one randomization are not independent, so neither the
+    // counts nor the bound of CHB decide alone; they are left to doTest
+    // after a -resume, whose randomizations miss the traces of the earlier
+    // runs
+    virtual void doRandomizedTest(const Randomizations &r, unsigned long int n, unsigned long int x)
+    {
+        if (!r.holds(n))
+        {
+            doTest(n, x);
+            return;
+        }
+        unsigned int R = r.n.size();
+        unsigned long int points = n / R;
+        if (n < 100 || n % R != 0 || (points & (points - 1)) != 0)
+            return;
+        int look = 1;
+        while (points / 2 * R >= 100)
+        {
+            points /= 2;
+            look++;
+        }
+        double mean, h;
+        randomizedInterval(r, n, 1 - (1 - coverage()) / pow(2.0, look), mean, h);
+        if (h > delta)
+            return;
+        if (x < 10 || n - x < 10)
+        {
+            doTest(n, x);
+            if (!done())
+                return;
+        }
+        out = DONE;
+        samples = n;
+        successes = x;
+        estimate = double(x) / double(n);
+        randomizations = R;
+        randomizedEstimate = mean;
+        halfWidth = h;
+    }
+
+    void decide(const Observations &o, unsigned long int n, unsigned long int x)
     {
+        out = DONE;
+        samples = n;
+        successes = x;
+        estimate = o.estimate();
+        reducedHalfWidth = o.halfWidth(coverage());
+        reduction = o.name();
     }
 
     // defined later because it uses a method from class CHB
     void printResult();
     double getEstimate();
+
+    // coverage of the interval of the randomizations
+    virtual double coverage()
+    {
+        return c;
+    }
+
+    // the mean of the estimates of the randomizations r of n samples and the
+    // half-width h of its Student interval of coverage c; returns the number
+    // of the randomizations drawn, 0 when they miss some of the n samples
+    // (the traces of a resumed run)
+    unsigned int randomizedInterval(const Randomizations &r, unsigned long int n, double c, double &mean, double &h)
+    {
+        double sum = 0, sum2 = 0;
+        unsigned int R = 0;
+        for (unsigned int i = 0; i < r.n.size(); i++)
+        {
+            if (r.n[i] == 0)
+                continue;
+            double p = double(r.x[i]) / double(r.n[i]);
+            sum += p;
+            sum2 += p * p;
+            R++;
+        }
+        if (!r.holds(n) || R < 2)
+            return 0;
+        mean = sum / R;
+        double var = max(0.0, (sum2 - R * mean * mean) / (R - 1));
+        h = gsl_cdf_tdist_Pinv((1 + c) / 2, R - 1) * sqrt(var / R);
+        return R;
+    }
+
+    // sets the interval of the randomizations of the samples the test was
+    // decided on, unless they miss some of them or doRandomizedTest set it
+    void setRandomized(const Randomizations &r)
+    {
+        double mean, h;
+        unsigned int R = randomizations > 0 ? 0 : randomizedInterval(r, samples, coverage(), mean, h);
+        if (R == 0)
+            return;
+        randomizations = R;
+        randomizedEstimate = mean;
+        halfWidth = h;
+    }
+
+    // the half-width of the interval of the randomizations or of the
+    // variance-reduced estimate, -1 without
+    double getHalfWidth()
+    {
+        return randomizations > 0 ? halfWidth : reducedHalfWidth;
+    }
+
+    void save(ostream &os)
+    {
+        Test::save(os);
+        os << " " << setprecision(17) << estimate << " " << reducedHalfWidth << " " << reduction;
+    }
+
+    void load(istream &is)
+    {
+        Test::load(is);
+        is >> estimate;
+        // the checkpoints of the runs before the variance reduction end here
+        if (!(is >> reducedHalfWidth))
+            reducedHalfWidth = -1;
+        getline(is >> ws, reduction);
+    }
 };
 double Estim::getEstimate()
 {
@@ -214,14 +745,12 @@ public:
         // sanity checks
         if ((delta >= 0.5) || (delta <= 0.0))
         {
-            cerr << args << " : must have 0 < delta < 0.5" << endl;
-            exit(EXIT_FAILURE);
+            Tools::fail(args + " : must have 0 < delta < 0.5");
         }
 
         if (c <= 0.0)
         {
-            cerr << args << " : must have c > 0" << endl;
-            exit(EXIT_FAILURE);
+            Tools::fail(args + " : must have c > 0");
         }
 
         // compute the Chernoff-Hoeffding bound
@@ -233,6 +762,11 @@ public:
         args = tmp.str();
     }
 
+    long remaining(unsigned long int n)
+    {
+        return (n >= N) ? 0 : N - n;
+    }
+
     void doTest(unsigned long int n, unsigned long int x)
     {
 
@@ -286,6 +820,28 @@ public:
         args = tmp.str();
     }
 
+    long remaining(unsigned long int n)
+    {
+        return (n >= N) ? 0 : N - n;
+    }
+
+    // c is the number of samples
+    double coverage()
+    {
+        return 0.95;
+    }
+
+    void doReducedTest(const Observations &o, unsigned long int n, unsigned long int x)
+    {
+        if (n >= N)
+            decide(o, n, x);
+    }
+
+    void doRandomizedTest(const Randomizations &r, unsigned long int n, unsigned long int x)
+    {
+        doTest(n, x);
+    }
+
     void doTest(unsigned long int n, unsigned long int x)
     {
 
@@ -331,6 +887,11 @@ void Estim::printResult()
                 abort();
             }
         }
+        if (reducedHalfWidth >= 0)
+            cout << ", half-width = " << reducedHalfWidth << " (" << coverage() * 100 << "%, " << reduction << ")";
+        if (randomizations > 0)
+            cout << ", RQMC estimate = " << randomizedEstimate << " +- " << halfWidth << " (" << coverage() * 100
+                 << "%, " << randomizations << " randomizations)";
         cout << endl;
         break;
     }
@@ -362,20 +923,17 @@ public:
         // sanity checks
         if ((delta > 0.5) || (delta <= 0.0))
         {
-            cerr << args << " : must have 0 < delta < 0.5" << endl;
-            exit(EXIT_FAILURE);
+            Tools::fail(args + " : must have 0 < delta < 0.5");
         }
 
         if (c <= 0.0)
         {
-            cerr << args << " : must have c > 0" << endl;
-            exit(EXIT_FAILURE);
+            Tools::fail(args + " : must have c > 0");
         }
 
         if ((alpha <= 0.0) || (beta <= 0.0))
         {
-            cerr << args << " : must have alpha, beta > 0" << endl;
-            exit(EXIT_FAILURE);
+            Tools::fail(args + " : must have alpha, beta > 0");
         }
 
         // writes back the test arguments, with proper formatting
@@ -384,6 +942,12 @@ public:
         args = tmp.str();
     }
 
+    // the posterior mean
+    double runningEstimate(unsigned long int n, unsigned long int x)
+    {
+        return (double(x) + alpha) / double(n + alpha + beta);
+    }
+
     void doTest(unsigned long int n, unsigned long int x)
     {
 
@@ -473,20 +1037,17 @@ public:
         // sanity checks
         if ((theta >= 1.0) || (theta <= 0.0))
         {
-            cerr << args << " : must have 0 < theta < 1" << endl;
-            exit(EXIT_FAILURE);
+            Tools::fail(args + " : must have 0 < theta < 1");
         }
 
         if (cpo <= 0.0)
         {
-            cerr << args << " : must have cost > 0" << endl;
-            exit(EXIT_FAILURE);
+            Tools::fail(args + " : must have cost > 0");
         }
 
         // initialize pseudo-random number generator
         r = gsl_rng_alloc(gsl_rng_mt19937);
-        srand(time(NULL));
-        gsl_rng_set(r, rand());
+        gsl_rng_set(r, RandomStream::getSeed());
 
         pi = atan(1) * 4;
 
@@ -583,6 +1144,12 @@ public:
     {
     }
 
+    // the error the threshold T stands for
+    double level()
+    {
+        return 1 / T;
+    }
+
     void init()
     { // initialize test parameters
 
@@ -596,20 +1163,17 @@ public:
         // sanity checks
         if (T <= 1.0)
         {
-            cerr << args << " : must have T > 1" << endl;
-            exit(EXIT_FAILURE);
+            Tools::fail(args + " : must have T > 1");
         }
 
         if ((theta >= 1.0) || (theta <= 0.0))
         {
-            cerr << args << " : must have 0 < theta < 1" << endl;
-            exit(EXIT_FAILURE);
+            Tools::fail(args + " : must have 0 < theta < 1");
         }
 
         if ((alpha <= 0.0) || (beta <= 0.0))
         {
-            cerr << args << " : must have alpha, beta > 0" << endl;
-            exit(EXIT_FAILURE);
+            Tools::fail(args + " : must have alpha, beta > 0");
         }
 
         // compute prior probability of the alternative hypothesis
@@ -618,8 +1182,7 @@ public:
         // sanity check
         if ((p1 >= 1.0) || (p1 <= 0.0))
         {
-            cerr << args << " : Prob(H_1) is either 0 or 1" << endl;
-            exit(EXIT_FAILURE);
+            Tools::fail(args + " : Prob(H_1) is either 0 or 1");
         }
         p0 = 1 - p1;
 
@@ -694,6 +1257,17 @@ public:
     {
     }
 
+    // the error the threshold T stands for
+    double level()
+    {
+        return 1 / T;
+    }
+
+    double indifference()
+    {
+        return delta;
+    }
+
     void init()
     { // initialize test parameters
 
@@ -707,26 +1281,22 @@ public:
         // sanity checks
         if (T <= 1.0)
         {
-            cerr << args << " : must have T > 1" << endl;
-            exit(EXIT_FAILURE);
+            Tools::fail(args + " : must have T > 1");
         }
 
         if ((theta >= 1.0) || (theta <= 0.0))
         {
-            cerr << args << " : must have 0 < theta < 1" << endl;
-            exit(EXIT_FAILURE);
+            Tools::fail(args + " : must have 0 < theta < 1");
         }
 
         if ((alpha <= 0.0) || (beta <= 0.0))
         {
-            cerr << args << " : must have alpha, beta > 0" << endl;
-            exit(EXIT_FAILURE);
+            Tools::fail(args + " : must have alpha, beta > 0");
         }
 
         if ((delta >= 0.5) || (delta <= 0.0))
         {
-            cerr << args << " : must have 0 < delta < 0.5" << endl;
-            exit(EXIT_FAILURE);
+            Tools::fail(args + " : must have 0 < delta < 0.5");
         }
 
         // prepare parameters
@@ -736,8 +1306,7 @@ public:
         // another sanity check
         if ((theta1 <= 0.0) || (theta2 >= 1.0))
         {
-            cerr << args << " : indifference region borders 0 or 1" << endl;
-            exit(EXIT_FAILURE);
+            Tools::fail(args + " : indifference region borders 0 or 1");
         }
 
         // compute prior probability of the alternative hypothesis
@@ -746,8 +1315,7 @@ public:
         // sanity check
         if ((p1 >= 1.0) || (p1 <= 0.0))
         {
-            cerr << args << " : Prob(H_1) is either 0 or 1" << endl;
-            exit(EXIT_FAILURE);
+            Tools::fail(args + " : Prob(H_1) is either 0 or 1");
         }
         p0 = 1 - p1;
 
@@ -809,6 +1377,17 @@ public:
     {
     }
 
+    // the error the threshold T stands for
+    double level()
+    {
+        return 1 / T;
+    }
+
+    double indifference()
+    {
+        return delta;
+    }
+
     void init()
     { // initialize test parameters
 
@@ -821,20 +1400,17 @@ public:
         // sanity checks
         if (T <= 1.0)
         {
-            cerr << args << " : must have T > 1" << endl;
-            exit(EXIT_FAILURE);
+            Tools::fail(args + " : must have T > 1");
         }
 
         if ((theta >= 1.0) || (theta <= 0.0))
         {
-            cerr << args << " : must have 0 < theta < 1" << endl;
-            exit(EXIT_FAILURE);
+            Tools::fail(args + " : must have 0 < theta < 1");
         }
 
         if ((delta >= 0.5) || (delta <= 0.0))
         {
-            cerr << args << " : must have 0 < delta < 0.5" << endl;
-            exit(EXIT_FAILURE);
+            Tools::fail(args + " : must have 0 < delta < 0.5");
         }
 
         // prepare parameters
@@ -844,8 +1420,7 @@ public:
         // another sanity check
         if ((theta1 <= 0.0) || (theta2 >= 1.0))
         {
-            cerr << args << " : indifference region borders 0 or 1" << endl;
-            exit(EXIT_FAILURE);
+            Tools::fail(args + " : indifference region borders 0 or 1");
         }
 
         // writes back the test arguments, with proper formatting
@@ -881,98 +1456,1271 @@ public:
         }
     }
 };
-void getFiles(vector<string> &files, string folder_name, string file_name)
+// do all the tests that are not done yet on n samples with x successes,
+// print the ones that finish (after label, if any, and unless print is false)
+// and return whether all of them are done. With -sampling qmc, the
+// estimation tests are decided on the interval of randomized; with
+// -antithetic, -control or -stratify they are decided on the observations
+// reduced, and with -proposal or -allocation neyman so are the hypothesis
+// tests.
+bool doTests(vector<Test *> &myTests, unsigned long int n, unsigned long int x, string label = "", bool print = true,
+             const Randomizations *randomized = NULL, const Observations *reduced = NULL)
 {
-    DIR *dp;
-    struct dirent *dirp;
-    if (!(dp = opendir(folder_name.c_str())))
-        printf("can't open");
-    string::size_type idx;
-    while (((dirp = readdir(dp)) != NULL))
+    ProfileScope scope(Profiler::TEST);
+    bool alldone = true;
+    for (unsigned int j = 0; j < myTests.size(); j++)
     {
-        string a = dirp->d_name;
-        idx = a.find(file_name);
-        if (idx == string::npos)
+        // do a test, if not done
+        bool done = myTests[j]->done();
+        if (!done)
         {
+            Estim *estim = dynamic_cast<Estim *>(myTests[j]);
+            HTest *htest = dynamic_cast<HTest *>(myTests[j]);
+            if (reduced != NULL && reduced->on() && estim != NULL)
+                estim->doReducedTest(*reduced, n, x);
+            else if (reduced != NULL && !reduced->nominal() && htest != NULL)
+                htest->doReducedTest(*reduced, n, x);
+            else if (randomized != NULL && randomized->n.size() > 1 && estim != NULL)
+                estim->doRandomizedTest(*randomized, n, x);
+            else
+                myTests[j]->doTest(n, x);
+            done = myTests[j]->done();
+            if (done && randomized != NULL && estim != NULL)
+                estim->setRandomized(*randomized);
+            if (done && print)
+            {
+                if (label != "")
+                    cout << label << endl;
+                myTests[j]->printResult();
+            }
         }
-        else
-            files.push_back(a);
+        alldone = alldone && done;
     }
-    closedir(dp);
-}
-string getmodelfilename(string folder_name, string file_name)
-{
-    vector<string> files;
-    getFiles(files, folder_name, file_name);
-    int size1 = files.size();
-    string newfile = folder_name + "/" + file_name + "_";
-    newfile += to_string(size1);
-    return newfile;
+    return alldone;
 }
-void creatFolder(string pDir)
+
+// Periodic progress reports of a run, every -progress <seconds>: a line on
+// the standard error and, with -progressjson <file>, one JSON object per
+// line in file. They give the traces and simulation steps per second since
+// the previous report, the running estimate of every test, the samples left
+// for the fixed-size tests and the time spent in every phase.
+class Progress
 {
-    int i = 0;
-    int iRet;
-    int iLen;
-    char *pszDir;
+private:
+    double period; // seconds between two reports, 0 when there is none
+    double start, last;
+    Profiler::Totals previous;
+    ofstream json;
 
-    pszDir = strdup(pDir.c_str());
-    iLen = strlen(pszDir);
+public:
+    Progress() : period(0), start(0), last(0)
+    {
+    }
 
-    // 创建中间目录
-    for (i = 0; i < iLen; i++)
+    void open(double p, string jsonfile)
     {
-        if (pszDir[i] == '\\' || pszDir[i] == '/')
+        period = p;
+        start = last = Profiler::now();
+        previous = Profiler::totals();
+        if (jsonfile != "")
         {
-            pszDir[i] = '\0';
-
-            //如果不存在,创建
-            iRet = access(pszDir, 0);
+            json.open(jsonfile);
+            if (!json.is_open())
+            {
+                cerr << "Error: cannot open progress file: " << jsonfile << endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+        Profiler::enabled = true;
+    }
+
+    bool on()
+    {
+        return period > 0;
+    }
+
+    bool due()
+    {
+        return period > 0 && Profiler::now() - last >= period;
+    }
+
+    // tests[k] are the tests of property k, on n[k] samples with x[k] successes
+    void report(vector<vector<Test *> > &tests, vector<unsigned long int> &n, vector<unsigned long int> &x)
+    {
+        double t = Profiler::now();
+        Profiler::Totals now = Profiler::totals();
+        double dt = max(t - last, 1e-9);
+        double tracerate = (now.traces - previous.traces) / dt;
+        double steprate = (now.steps - previous.steps) / dt;
+        ostringstream line, js;
+        line << fixed << setprecision(1) << "Progress: " << t - start << " s, " << now.traces << " traces ("
+             << tracerate << "/s), " << now.steps << " steps (" << steprate << "/s)";
+        js << setprecision(10) << "{\"elapsed\":" << t - start << ",\"traces\":" << now.traces
+           << ",\"traces_per_s\":" << tracerate << ",\"steps\":" << now.steps << ",\"steps_per_s\":" << steprate
+           << ",\"tests\":[";
+        for (unsigned int k = 0; k < tests.size(); k++)
+        {
+            for (unsigned int j = 0; j < tests[k].size(); j++)
+            {
+                Test *T = tests[k][j];
+                unsigned long int samples = T->done() ? T->getSamples() : n[k];
+                unsigned long int successes = T->done() ? T->getSuccesses() : x[k];
+                double estimate = T->runningEstimate(samples, successes);
+                long left = T->done() ? 0 : T->remaining(samples);
+                line << " | ";
+                if (tests.size() > 1)
+                    line << "P" << k + 1 << " ";
+                line << T->getArgs() << ": " << setprecision(4) << estimate;
+                if (T->done())
+                    line << " (done)";
+                else if (left >= 0)
+                    line << " (" << left << " left)";
+                if (k + j > 0)
+                    js << ",";
+                js << "{\"property\":" << k + 1 << ",\"test\":\"" << T->getArgs() << "\",\"samples\":" << samples
+                   << ",\"successes\":" << successes << ",\"estimate\":" << estimate << ",\"remaining\":";
+                if (left >= 0)
+                    js << left;
+                else
+                    js << "null";
+                js << ",\"done\":" << (T->done() ? "true" : "false") << "}";
+            }
+        }
+        double total = 0;
+        for (int p = 0; p < Profiler::NPHASES; p++)
+            total += now.time[p];
+        line << " |";
+        js << "],\"phases\":{";
+        for (int p = 0; p < Profiler::NPHASES; p++)
+        {
+            line << " " << Profiler::phaseName[p] << " " << setprecision(0) << (total > 0 ? 100 * now.time[p] / total : 0) << "%";
+            js << (p > 0 ? "," : "") << "\"" << Profiler::phaseName[p] << "\":" << now.time[p];
+        }
+        js << "}}";
+        cerr << line.str() << endl;
+        if (json.is_open())
+            json << js.str() << endl;
+        previous = now;
+        last = t;
+    }
+
+    // the same for the tests of a single property
+    void report(vector<Test *> &tests, unsigned long int n, unsigned long int x)
+    {
+        vector<vector<Test *> > t(1, tests);
+        vector<unsigned long int> vn(1, n), vx(1, x);
+        report(t, vn, vx);
+    }
+};
+Progress progress;
+
+// Checkpoint of an SMC() run: its arguments and seed, its trace folder,
+// the index of the first trace not accounted yet and, for every property,
+// the counts and the state of every test. The traces only depend on the
+// seed and their index, so this is enough to resume the run exactly where
+// it stopped. The file is written to a temporary and renamed over the
+// previous one, so that a killed run always leaves a complete checkpoint.
+class Checkpoint
+{
+private:
+    string file;   // "" when no checkpoint is written
+    double period; // seconds between two checkpoints
+    time_t last;   // when the last one was written
+
+public:
+    string folder;                      // trace folder of the run
+    unsigned long int next;             // first trace not accounted yet
+    vector<unsigned long int> totnum;   // per property, total samples
+    vector<unsigned long int> satnum;   // per property, sat samples
+    vector<string> observations;        // per property, the state of its Observations, "" if off
+
+    Checkpoint(string f, double p) : file(f), period(p), last(time(NULL)), next(0)
+    {
+    }
+
+    // whether the next checkpoint is due
+    bool due()
+    {
+        return file != "" && difftime(time(NULL), last) >= period;
+    }
+
+    void save(map<string, string> &mapArgv, vector<vector<Test *> > &myTests)
+    {
+        string tmpfile = file + ".tmp";
+        ofstream out(tmpfile);
+        out << "SMC4WM checkpoint" << endl;
+        for (map<string, string>::iterator it = mapArgv.begin(); it != mapArgv.end(); it++)
+        {
+            if (it->first != "-resume" && it->second != "")
+                out << "arg " << it->first << " " << it->second << endl;
+        }
+        out << "folder " << folder << endl;
+        out << "next " << next << endl;
+        for (unsigned int k = 0; k < myTests.size(); k++)
+        {
+            out << "property " << totnum[k] << " " << satnum[k] << " " << myTests[k].size() << endl;
+            for (unsigned int j = 0; j < myTests[k].size(); j++)
+            {
+                out << "test ";
+                myTests[k][j]->save(out);
+                out << endl;
+            }
+            if (k < observations.size() && observations[k] != "")
+                out << "observations " << observations[k] << endl;
+        }
+        out << "end" << endl;
+        out.close();
+        if (!out || rename(tmpfile.c_str(), file.c_str()) != 0)
+        {
+            cerr << "Error: cannot write checkpoint: " << file << endl;
+            exit(EXIT_FAILURE);
+        }
+        last = time(NULL);
+    }
+
+    // arguments of the run saved in file, they replace the ones of mapArgv
+    // except the ones that only tell how to checkpoint
+    static void loadArgs(string file, map<string, string> &mapArgv)
+    {
+        ifstream in(file);
+        string line, keyword, key, value;
+        if (!in.is_open())
+        {
+            cerr << "Error: cannot open checkpoint: " << file << endl;
+            exit(EXIT_FAILURE);
+        }
+        while (getline(in, line))
+        {
+            istringstream iline(line);
+            iline >> keyword;
+            if (keyword != "arg")
+                continue;
+            iline >> key;
+            value = "";
+            getline(iline >> ws, value);
+            if (key != "-checkpoint" && key != "-checkpointperiod")
+                mapArgv[key] = value;
+        }
+    }
+
+    // state of the run saved in file, the tests must be the ones of the run
+    void load(string file, vector<vector<Test *> > &myTests)
+    {
+        ifstream in(file);
+        string line, keyword;
+        unsigned int k = 0, numtests;
+        bool complete = false;
+        totnum.assign(myTests.size(), 0);
+        satnum.assign(myTests.size(), 0);
+        observations.assign(myTests.size(), "");
+        while (getline(in, line))
+        {
+            istringstream iline(line);
+            iline >> keyword;
+            if (keyword == "folder")
+                getline(iline >> ws, folder);
+            else if (keyword == "next")
+                iline >> next;
+            else if (keyword == "property")
+            {
+                if (k >= myTests.size())
+                    break;
+                iline >> totnum[k] >> satnum[k] >> numtests;
+                if (numtests != myTests[k].size())
+                    break;
+                for (unsigned int j = 0; j < numtests && getline(in, line); j++)
+                {
+                    istringstream tline(line);
+                    tline >> keyword;
+                    myTests[k][j]->load(tline);
+                }
+                k++;
+            }
+            else if (keyword == "observations" && k > 0)
+                getline(iline >> ws, observations[k - 1]);
+            else if (keyword == "end")
+                complete = (k == myTests.size());
+        }
+        if (!complete)
+        {
+            cerr << "Error: checkpoint does not match the properties and tests of the run: " << file << endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+};
+
+// Lock-free bookkeeping of the samples of the asynchronous mode.
+//
+// Every sample gets a ticket when its generation starts and its worker
+// publishes the result in the slot of that ticket without waiting for
+// anybody. The coordinator only consumes the contiguous prefix of finished
+// tickets, so the tests see the samples in the order they were started,
+// whatever the order in which they finished: a long trace can not bias the
+// statistics, and samples still in flight when a test stops are never
+// counted.
+template <class Result>
+class SampleWindow
+{
+private:
+    vector<Result> slot;        // results of tickets [head, head + slot.size())
+    vector<atomic<bool> > full; // whether the result of a slot is published
+    atomic<unsigned long> next; // next ticket to hand out
+    atomic<unsigned long> head; // first ticket not consumed yet
+
+public:
+    SampleWindow(unsigned long size, unsigned long first) : slot(size), full(size), next(first), head(first)
+    {
+        for (unsigned long i = 0; i < size; i++)
+            full[i].store(false);
+    }
+
+    // hands out the next ticket, fails if the window is full
+    bool take(unsigned long &ticket)
+    {
+        unsigned long t = next.load();
+        do
+        {
+            if (t >= head.load() + slot.size())
+                return false;
+        } while (!next.compare_exchange_weak(t, t + 1));
+        ticket = t;
+        return true;
+    }
+
+    void publish(unsigned long ticket, const Result &r)
+    {
+        slot[ticket % slot.size()] = r;
+        full[ticket % slot.size()].store(true, memory_order_release);
+    }
+
+    // only called by the coordinator: fetches the result of ticket head
+    bool pop(Result &r)
+    {
+        unsigned long h = head.load();
+        if (!full[h % slot.size()].load(memory_order_acquire))
+            return false;
+        r = slot[h % slot.size()];
+        full[h % slot.size()].store(false);
+        head.store(h + 1);
+        return true;
+    }
+};
+
+// Sampling loop of the asynchronous mode.
+//
+// produce(tid, ticket) generates and checks the sample of the given ticket
+// in thread tid and returns its result, of any copyable type. consume(r)
+// accounts one result, in ticket order, and returns true when no more
+// samples are needed. Thread 0 consumes the results between its own
+// samples; no thread ever waits at a barrier. The tickets start at first.
+template <class Produce, class Consume>
+void runAsync(int maxthreads, Produce produce, Consume consume, unsigned long first = 0)
+{
+    typedef decltype(produce(0, 0UL)) Result;
+    SampleWindow<Result> window(1024 * (unsigned long)maxthreads, first);
+    atomic<bool> stop(false);
+#pragma omp parallel num_threads(maxthreads)
+    {
+        int tid = omp_get_thread_num();
+
+        // check whether we got all the threads requested
+        if (tid == 0)
+        {
+            if (maxthreads != omp_get_num_threads())
+            {
+                cerr << "Error: cannot use maximum number of threads" << endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+        while (!stop.load())
+        {
+            // only the master thread executes this
+            if (tid == 0)
+            {
+                Result r;
+                while (!stop.load() && window.pop(r))
+                {
+                    if (consume(r))
+                        stop.store(true);
+                }
+                if (stop.load())
+                    break;
+            }
+            unsigned long ticket;
+            if (!window.take(ticket))
+            {
+                // too far ahead of the coordinator
+                sched_yield();
+                continue;
+            }
+            window.publish(ticket, produce(tid, ticket));
+        }
+    }
+}
+// Coordinator of a distributed run.
+//
+// Workers (./SMC_wm -worker <address>) may connect at any time. They get
+// the configuration of the run, then batches of consecutive trace indices,
+// two at a time so that they never wait for the next one, and send back one
+// result per trace and per property. The batches are accounted in the order
+// of their traces, whatever the order in which they come back, so the tests
+// stop at the same trace as a local run with the same seed. The batch of a
+// worker that disconnects is handed to another one.
+//
+// consume(r) accounts the results of one trace and returns true when no
+// more traces are needed, then every worker is told to stop.
+template <class Consume>
+void coordinate(string address, vector<string> config, unsigned long first, unsigned long batch,
+                vector<atomic<bool> > &decided, Consume consume)
+{
+    typedef pair<unsigned long, unsigned long> Batch; // first trace, number of traces
+    int listenfd = Connection::listenOn(address);
+    cout << "Coordinator listening on " << address << endl;
+
+    vector<Connection> workers;
+    vector<deque<Batch> > inflight;               // batches handed to every worker
+    deque<Batch> orphans;                         // batches of the workers that are gone
+    map<unsigned long, vector<string> > finished; // results of the batches not accounted yet
+    unsigned long next = first;                   // first trace not handed out yet
+    bool stop = false;
+    while (!stop)
+    {
+        vector<pollfd> fds(workers.size() + 1);
+        fds[0].fd = listenfd;
+        fds[0].events = POLLIN;
+        for (unsigned int i = 0; i < workers.size(); i++)
+        {
+            fds[i + 1].fd = workers[i].fd;
+            fds[i + 1].events = POLLIN;
+        }
+        if (poll(&fds[0], fds.size(), -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            cerr << "Error: poll() failed in the coordinator" << endl;
+            exit(EXIT_FAILURE);
+        }
+        if (fds[0].revents & POLLIN)
+        {
+            Connection worker = Connection::acceptFrom(listenfd);
+            if (worker.fd >= 0)
+            {
+                for (unsigned int j = 0; j < config.size(); j++)
+                    worker.writeLine(config[j]);
+                workers.push_back(worker);
+                inflight.push_back(deque<Batch>());
+            }
+        }
+        for (unsigned int i = 0; i + 1 < fds.size(); i++)
+        {
+            if (!(fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)))
+                continue;
+            bool alive = workers[i].fill();
+            string line, keyword;
+            while (workers[i].nextLine(line))
+            {
+                istringstream iline(line);
+                iline >> keyword;
+                if (keyword != "RESULT")
+                    continue;
+                unsigned long f, n, steps;
+                vector<string> r(decided.size());
+                iline >> f >> n >> steps;
+                Profiler::addTraces(n, steps);
+                for (unsigned int k = 0; k < r.size(); k++)
+                    iline >> r[k];
+                finished[f] = r;
+                for (unsigned int j = 0; j < inflight[i].size(); j++)
+                {
+                    if (inflight[i][j].first == f)
+                    {
+                        inflight[i].erase(inflight[i].begin() + j);
+                        break;
+                    }
+                }
+            }
+            if (!alive)
+            {
+                orphans.insert(orphans.end(), inflight[i].begin(), inflight[i].end());
+                inflight[i].clear();
+                workers[i].close();
+            }
+        }
+        for (unsigned int i = workers.size(); i-- > 0;)
+        {
+            if (workers[i].fd < 0)
+            {
+                workers.erase(workers.begin() + i);
+                inflight.erase(inflight.begin() + i);
+            }
+        }
+
+        // account the batches that come next in the order of the traces
+        while (!stop && finished.count(first) > 0)
+        {
+            vector<string> &r = finished[first];
+            unsigned long n = r[0].size();
+            for (unsigned long j = 0; j < n && !stop; j++)
+            {
+                vector<int> res(r.size());
+                for (unsigned int k = 0; k < r.size(); k++)
+                    res[k] = (r[k][j] == '1') ? 1 : ((r[k][j] == '0') ? 0 : -1);
+                stop = consume(res);
+            }
+            finished.erase(first);
+            first += n;
+        }
+
+        // keep two batches in flight on every worker
+        for (unsigned int i = 0; i < workers.size() && !stop; i++)
+        {
+            while (inflight[i].size() < 2)
+            {
+                Batch b(next, batch);
+                if (orphans.size() > 0)
+                {
+                    b = orphans.front();
+                    orphans.pop_front();
+                }
+                else
+                    next += batch;
+                string mask = "";
+                for (unsigned int k = 0; k < decided.size(); k++)
+                    mask += decided[k].load() ? "0" : "1";
+                workers[i].writeLine("BATCH " + to_string(b.first) + " " + to_string(b.second) + " " + mask);
+                inflight[i].push_back(b);
+            }
+        }
+    }
+    for (unsigned int i = 0; i < workers.size(); i++)
+    {
+        workers[i].writeLine("STOP");
+        workers[i].close();
+    }
+    close(listenfd);
+    if (address.compare(0, 5, "unix:") == 0)
+        unlink(address.substr(5).c_str());
+}
+void getFiles(vector<string> &files, string folder_name, string file_name)
+{
+    DIR *dp;
+    struct dirent *dirp;
+    if (!(dp = opendir(folder_name.c_str())))
+        printf("can't open");
+    string::size_type idx;
+    while (((dirp = readdir(dp)) != NULL))
+    {
+        string a = dirp->d_name;
+        idx = a.find(file_name);
+        if (idx == string::npos)
+        {
+        }
+        else
+            files.push_back(a);
+    }
+    closedir(dp);
+}
+string getmodelfilename(string folder_name, string file_name)
+{
+    vector<string> files;
+    getFiles(files, folder_name, file_name);
+    int size1 = files.size();
+    string newfile = folder_name + "/" + file_name + "_";
+    newfile += to_string(size1);
+    return newfile;
+}
+void creatFolder(string pDir)
+{
+    int i = 0;
+    int iRet;
+    int iLen;
+    char *pszDir;
+
+    pszDir = strdup(pDir.c_str());
+    iLen = strlen(pszDir);
+
+    // 创建中间目录
+    for (i = 0; i < iLen; i++)
+    {
+        if (pszDir[i] == '\\' || pszDir[i] == '/')
+        {
+            pszDir[i] = '\0';
+
+            //如果不存在,创建
+            iRet = access(pszDir, 0);
             if (iRet != 0)
             {
-                iRet = mkdir(pszDir, 0755);
+                iRet = mkdir(pszDir, 0755);
+            }
+            //支持linux,将所有\换成/
+            pszDir[i] = '/';
+        }
+    }
+
+    iRet = mkdir(pszDir, 0755);
+    free(pszDir);
+}
+// -sampling qmc: the traces are the points of -randomizations scrambled
+// Sobol sequences instead of independent draws
+void useSampling(map<string, string> &mapArgv)
+{
+    Tools tools;
+    if (mapArgv["-antithetic"] != "" && mapArgv["-antithetic"] != "true" && mapArgv["-antithetic"] != "false")
+        Tools::fail("Error: -antithetic is true or false.");
+    if (mapArgv["-antithetic"] == "true")
+    {
+        if (mapArgv["-sampling"] == "qmc")
+            Tools::fail("Error: -antithetic is for -sampling mc.");
+        RandomStream::setAntithetic(true);
+        cout << "Antithetic pairs of traces." << endl;
+    }
+    if (mapArgv["-sampling"] == "" || mapArgv["-sampling"] == "mc")
+        return;
+    if (mapArgv["-control"] != "")
+        Tools::fail("Error: -control is for -sampling mc.");
+    if (mapArgv["-sampling"] != "qmc")
+        Tools::fail("Error: -sampling is mc or qmc.");
+    unsigned int R = 16;
+    if (mapArgv["-randomizations"] != "")
+    {
+        if (!tools.isInt(mapArgv["-randomizations"]) || tools.str2int(mapArgv["-randomizations"]) < 2)
+            Tools::fail("Error: the number of randomizations must be an integer of at least 2.");
+        R = tools.str2int(mapArgv["-randomizations"]);
+    }
+    RandomStream::setRandomizations(R);
+    cout << "Quasi-Monte Carlo sampling, " << R << " randomizations." << endl;
+}
+// -native true: the steps of the traces of S run as native code, built once
+// per model in the -nativedir cache; S keeps interpreting its operations
+// when they cannot be compiled
+void useNative(map<string, string> &mapArgv, Sampler &S)
+{
+    if (mapArgv["-native"] != "true" || S.sampler_type != 1)
+        return;
+    string why;
+    string directory = mapArgv["-nativedir"] != "" ? mapArgv["-nativedir"] : "../native";
+    S.native = NativeModel::load(*S.model, directory, why);
+    if (S.native == NULL)
+        cout << "Native code: " << why << ", interpreting." << endl;
+    else
+        cout << "Native code: " << S.native->library << endl;
+}
+// -native build: builds the native code of the model ahead of the runs that
+// load it, and exits
+void buildNative(map<string, string> &mapArgv)
+{
+    if (mapArgv["-modelfile"] == "")
+        Tools::fail("Error: -native build needs a -modelfile.");
+    Sampler S(mapArgv["-modelfile"], mapArgv["-interfile"]);
+    string why;
+    string directory = mapArgv["-nativedir"] != "" ? mapArgv["-nativedir"] : "../native";
+    string library = NativeModel::build(*S.model, directory, why);
+    if (library == "")
+        Tools::fail("Error: no native code for " + mapArgv["-modelfile"] + ": " + why + ".");
+    cout << library << endl;
+    exit(EXIT_SUCCESS);
+}
+// the score of the steps of property, for -splitting and -proposal ce: the
+// value of -score [-]<variable>, or the one derived from the property
+Splitting::Score readScore(map<string, string> &mapArgv, const Model &model, interface &property)
+{
+    Tools tools;
+    Splitting::Score score;
+    if (mapArgv["-score"] == "")
+    {
+        string why;
+        if (!Splitting::derive(property.formula, model, score, why))
+            Tools::fail("Error: no score for " + property.formulaText + ": " + why + ", give one with -score.");
+        return score;
+    }
+    string spec = mapArgv["-score"];
+    tools.string_replace(spec, " ", "");
+    score.sign = spec[0] == '-' ? -1 : 1;
+    if (spec[0] == '-' || spec[0] == '+')
+        spec = spec.substr(1);
+    if (model.variableIndex.count(spec) == 0)
+        Tools::fail("Error: unknown variable of -score: " + spec + ".");
+    score.variable = model.variableIndex.find(spec)->second;
+    score.threshold = 0;
+    return score;
+}
+// Generates the traces of a run and checks them against its properties.
+//
+// inprocess: load the model and parse the property once, every thread
+//            checks its own copy of them
+// check:     spawn the ./Check binary for every sample
+//
+// The traces only depend on the seed and their index, so any process that
+// builds a TraceChecker from the same arguments draws the same traces: the
+// ./Check processes and the workers of a distributed run.
+class TraceChecker
+{
+private:
+    string engine;
+    Sampler model;
+    vector<Sampler> states; // of the traces of every thread, started over for every trace
+    vector<string> callTC; // command line of ./Check, per property
+
+    // the pilot traces of -stratify, the rounds of -proposal ce and the
+    // draws of the mean of -control are PILOT + i, not traces of the run: they
+    // only choose the strata, the proposal or the mean, so that the estimates
+    // stay unbiased
+    static const uint64_t PILOT = 1ULL << 62;
+
+    // the integer option flag, byDefault when not given, of at least least
+    static int count(map<string, string> &mapArgv, string flag, int byDefault, int least)
+    {
+        Tools tools;
+        if (mapArgv[flag] == "")
+            return byDefault;
+        if (!tools.isInt(mapArgv[flag]) || tools.str2int(mapArgv[flag]) < least)
+            Tools::fail("Error: " + flag + " must be an integer of at least " + to_string(least) + ".");
+        return tools.str2int(mapArgv[flag]);
+    }
+
+public:
+    vector<string> propFolder; // where the traces of every property go
+    vector<string> propFile;   // the property files given to ./Check
+    // -control <variable>[<step>]: every trace also gives the value of the
+    // variable at that step, whose mean controlMean is known in closed form
+    // but for the draws of the beta variables, of variance controlVariance
+    bool controlled;
+    double controlMean, controlVariance;
+    // -stratify: the strata of the traces, NULL if not stratified
+    shared_ptr<const Strata> strata;
+    // -proposal: the traces are drawn from a proposal and weighted by their
+    // likelihood ratio
+    bool weighted;
+
+    // generate is false when the traces are generated by other processes and
+    // only the folders of the run are needed; loaded is the model of the run
+    // when it is already loaded
+    TraceChecker(map<string, string> &mapArgv, vector<interface> &properties, string folderName, bool generate,
+                 const Sampler *loaded = NULL)
+    {
+        unsigned int numprops = properties.size();
+        controlled = false;
+        controlMean = 0;
+        controlVariance = 0;
+        weighted = false;
+
+        // the traces of property k go to propFolder[k], a subfolder P<k> of the
+        // run folder as soon as there are several properties
+        propFolder.assign(numprops, folderName);
+        propFile.assign(numprops, mapArgv["-propfile"]);
+        for (unsigned int k = 0; k < numprops; k++)
+        {
+            if (numprops > 1)
+            {
+                propFolder[k] = folderName + "/P" + to_string(k + 1);
+                propFile[k] = propFolder[k] + "/PROPERTY";
+                creatFolder(propFolder[k]);
+                ofstream formulafile(propFile[k]);
+                formulafile << properties[k].formulaText << endl;
+                formulafile.close();
+            }
+            creatFolder(propFolder[k] + "/SAT");
+            creatFolder(propFolder[k] + "/UNSAT");
+        }
+
+        engine = mapArgv["-engine"];
+        if (engine == "")
+            engine = "inprocess";
+        if (engine != "inprocess" && engine != "check")
+        {
+            Tools::fail("Error: unknown engine: " + engine);
+        }
+        if (mapArgv["-control"] != "" && (!generate || engine != "inprocess"))
+            Tools::fail("Error: -control needs the inprocess engine and the traces drawn in this process.");
+        if (mapArgv["-stratify"] != "" && (!generate || engine != "inprocess"))
+            Tools::fail("Error: -stratify needs the inprocess engine and the traces drawn in this process.");
+        if (mapArgv["-proposal"] != "" && (!generate || engine != "inprocess"))
+            Tools::fail("Error: -proposal needs the inprocess engine and the traces drawn in this process.");
+        if (!generate)
+            return;
+        if (engine == "inprocess" && loaded != NULL)
+            model = *loaded;
+        else if (engine == "inprocess")
+        {
+            model = Sampler(mapArgv["-modelfile"], mapArgv["-interfile"]);
+            model.getInital(mapArgv["-initfile"]);
+        }
+        // -savetraces false: the checkers consume the steps as they are
+        // drawn, nothing is kept nor written
+        if (mapArgv["-savetraces"] == "false")
+            model.setStorage(Sampler::STORE_NONE);
+        useNative(mapArgv, model);
+        if (mapArgv["-control"] != "")
+            setControl(mapArgv);
+        if (mapArgv["-stratify"] != "")
+            setStrata(mapArgv, properties);
+        if (mapArgv["-proposal"] != "")
+            setProposal(mapArgv, properties);
+        states.assign(omp_get_max_threads(), model);
+
+        // @Ziqiang, this is the first place to fill after you modify the ``bound'' input parameter
+        // My suggestion is that you may want to add a function in the trace checker that, once it takes
+        // in a BLTL, parse the formula and compute the bound in the way that I mention in the wechat.
+
+        // build the command line to call sampler_and_tracechecker (I will call it as TC in the following)
+        std::string TCpath = "./Check "; // the path to the exectuable binary of TC, not visible for users
+        //std::string callTC = TCpath + string(argv[2]) + " " + string(argv[3]) + " " + folderName; // only model and property are inputs for TC
+        string callArgs = "";
+        if (mapArgv["-interfile"] != "")
+            callArgs += " " + mapArgv["-interfile"];
+        if (mapArgv["-initfile"] != "")
+            callArgs += " " + mapArgv["-initfile"];
+        else
+            callArgs += " ../testcase/bmi_config.txt";
+        callTC.assign(numprops, "");
+        for (unsigned int k = 0; k < numprops; k++)
+            callTC[k] = TCpath + mapArgv["-modelfile"] + " " + propFile[k] + " " + propFolder[k] + callArgs;
+
+        // the ./Check processes draw their traces from the same seed
+        setenv("SMC4WM_SEED", to_string(RandomStream::getSeed()).c_str(), 1);
+        setenv("SMC4WM_RANDOMIZATIONS", to_string(RandomStream::getRandomizations()).c_str(), 1);
+        setenv("SMC4WM_ANTITHETIC", RandomStream::getAntithetic() ? "1" : "0", 1);
+    }
+
+    // generates trace traceIndex and checks it against the properties k of
+    // I1 such that active[k], returns for every property 1 if the trace
+    // satisfies it, 0 if it does not and -1 if it was not checked
+    vector<int> check(vector<interface> &I1, int traceIndex, vector<bool> active)
+    {
+        if (engine == "inprocess")
+        {
+            Sampler &S = states[omp_get_thread_num()];
+            S.reset(traceIndex);
+            S.resetBeta();
+            vector<int> r = interface::checkmodel(S, I1, propFolder, traceIndex, active);
+            if (controlled)
+            {
+                // the trace goes on to the control step if it stopped before
+                while (S.sample_size <= S.controlRow)
+                    S.get_one_sample();
+                lock_guard<mutex> lock(controlsMutex);
+                controls[traceIndex] = S.controlValue;
+            }
+            if (weighted)
+            {
+                lock_guard<mutex> lock(controlsMutex);
+                likelihoods[traceIndex] = exp(S.logWeight);
+            }
+            return r;
+        }
+        // the ./Check processes of one trace index all draw the same trace
+        ProfileScope scope(Profiler::CHECK);
+        Profiler::addTraces(1, 0);
+        vector<int> rets(I1.size(), -1);
+        for (unsigned int k = 0; k < I1.size(); k++)
+        {
+            if (!active[k])
+                continue;
+            // @Ziqiang, make sure that TC will return 1 if the trace checkers says unsat, and 0 otherwise
+            int ret; // code returned by trace checker
+            string callTC_temp = callTC[k] + " " + to_string(traceIndex);
+            //cout<<callTC<<endl;
+
+            // call TC
+            /**/
+            FILE *fp;
+            fp = popen(callTC_temp.c_str(), "r");
+            char result_buf[MAXLINE], command[MAXLINE];
+            int rc = 0;
+            if (NULL == fp)
+            {
+                cerr << "Error: system() call to the trace checker terminated abnormally: " << callTC_temp << endl;
+                exit(EXIT_FAILURE);
+            }
+            while (fgets(result_buf, sizeof(result_buf), fp) != NULL)
+            {
             }
-            //支持linux,将所有\换成/
-            pszDir[i] = '/';
+            ret = pclose(fp);
+            //cout<<ret<<endl;
+            if (ret != 0 && ret != 256)
+            {
+                cerr << "Error: system() call to the trace checker unsuccessful: " << callTC_temp << endl;
+                exit(EXIT_FAILURE);
+            }
+            ret = WEXITSTATUS(ret);
+            //cout<<ret<<"***"<<endl;
+            if (ret != 1 && ret != 0)
+            {
+                cerr << "Error: system() call to the trace checker unsuccessful: " << endl;
+                exit(EXIT_FAILURE);
+            }
+            rets[k] = ret;
         }
+        return rets;
     }
 
-    iRet = mkdir(pszDir, 0755);
-    free(pszDir);
-}
-void SMC(map<string, string> mapArgv)
-{
-    cout << "This is a paralleled version." << endl;
-    //cout << mapArgv["-testfile"] << endl;
-    //cout << mapArgv["-modelfile"] << endl;
-    //cout << mapArgv["-propfile"] << endl;
+    // check() for the count traces from first on, drawn side by side by a
+    // BatchSampler when the engine and the model allow it
+    vector<vector<int> > check(vector<interface> &I1, int first, int count, vector<bool> active)
+    {
+        if (engine == "inprocess" && count > 1 && !controlled && !weighted && BatchSampler::supports(model))
+        {
+            BatchSampler B(model, first, count);
+            return interface::checkmodel(B, I1, propFolder, active);
+        }
+        vector<vector<int> > rets;
+        for (int i = 0; i < count; i++)
+            rets.push_back(check(I1, first + i, active));
+        return rets;
+    }
 
-    bool alldone = false; // all tests done
-    bool done;
-    unsigned long int satnum = 0; // number of sat samples
-    unsigned long int totnum = 0; // number of total samples
-    unsigned int numtests = 0;    // number of tests to perform
+    // what the estimation tests of a property are decided on
+    Observations observations()
+    {
+        return Observations(RandomStream::getAntithetic(), controlled, controlMean, controlVariance,
+                            strata == NULL ? vector<double>() : strata->weights,
+                            strata != NULL && !strata->proportional, weighted);
+    }
+
+    // the stratum of trace, -1 if not stratified
+    int stratum(unsigned long int trace)
+    {
+        return strata == NULL ? -1 : strata->of((uint64_t)trace);
+    }
+
+    // the control value of trace, once it is checked
+    double control(unsigned long int trace)
+    {
+        lock_guard<mutex> lock(controlsMutex);
+        map<unsigned long int, double>::iterator it = controls.find(trace);
+        double g = it->second;
+        controls.erase(it);
+        return g;
+    }
+
+    // the likelihood ratio of trace, once it is checked
+    double weight(unsigned long int trace)
+    {
+        lock_guard<mutex> lock(controlsMutex);
+        map<unsigned long int, double>::iterator it = likelihoods.find(trace);
+        double w = it->second;
+        likelihoods.erase(it);
+        return w;
+    }
+
+private:
+    map<unsigned long int, double> controls;    // of the traces checked and not accounted yet
+    map<unsigned long int, double> likelihoods; // the same for the likelihood ratios
+    mutex controlsMutex;
+
+    // the variable and step of -control and the mean of the variable there,
+    // in closed form: the model must be linear-Gaussian
+    void setControl(map<string, string> &mapArgv)
+    {
+        Tools tools;
+        string spec = mapArgv["-control"];
+        tools.string_replace(spec, " ", "");
+        size_t open = spec.find('['), close = spec.find(']');
+        if (open == string::npos || close != spec.size() - 1 || !tools.isInt(spec.substr(open + 1, close - open - 1)) ||
+            tools.str2int(spec.substr(open + 1, close - open - 1)) < 1)
+            Tools::fail("Error: -control is <variable>[<step>], the step at least 1.");
+        string variable = spec.substr(0, open);
+        int step = tools.str2int(spec.substr(open + 1, close - open - 1));
+        int draws = 1000;
+        if (mapArgv["-exactdraws"] != "")
+        {
+            if (!tools.isInt(mapArgv["-exactdraws"]) || tools.str2int(mapArgv["-exactdraws"]) <= 0)
+                Tools::fail("Error: the number of draws must be a positive integer.");
+            draws = tools.str2int(mapArgv["-exactdraws"]);
+        }
+        // the draws of the beta variables are pilot traces, independent of
+        // the traces of the run
+        LinearGaussian exact(model, variable, step, draws, PILOT);
+        if (!exact.linear)
+            Tools::fail("Error: the mean of the control variate has no closed form: " + exact.why + ".");
+        controlled = true;
+        double error;
+        controlMean = exact.mean(&error);
+        controlVariance = exact.meanVariance();
+        model.controlVariable = model.getVariableX(variable);
+        model.controlRow = step - 1;
+        cout << "Control variate " << spec << ", mean " << controlMean;
+        if (error > 0)
+            cout << " +- " << error << " (95%, " << exact.means.size() << " draws of the beta variables)";
+        cout << "." << endl;
+    }
+
+    // the strata of -stratify <variables>|auto, by the groups of -stratabins
+    // <g> (4) bins of the beta variables; auto takes the -stratavariables <k>
+    // (2) of them whose groups explain most of the variance of the results
+    // of a pilot run of -pilot <n> (1000) traces, which also gives the
+    // standard deviations of the strata of -allocation neyman
+    void setStrata(map<string, string> &mapArgv, vector<interface> &properties)
+    {
+        Tools tools;
+        if (model.sampler_type != 1)
+            Tools::fail("Error: -stratify needs a DBN.");
+        if (mapArgv["-antithetic"] == "true" || mapArgv["-control"] != "" || mapArgv["-sampling"] == "qmc" ||
+            mapArgv["-proposal"] != "")
+            Tools::fail("Error: -stratify does not combine with -antithetic, -control, -proposal or -sampling qmc.");
+        int groups = count(mapArgv, "-stratabins", 4, 2);
+        string allocation = mapArgv["-allocation"] == "" ? "proportional" : mapArgv["-allocation"];
+        if (allocation != "proportional" && allocation != "neyman")
+            Tools::fail("Error: -allocation is proportional or neyman.");
+        shared_ptr<Strata> s = make_shared<Strata>(*model.model, groups);
+        if (s->betas.empty())
+            Tools::fail("Error: -stratify needs beta variables.");
+
+        vector<int> variables;
+        bool automatic = mapArgv["-stratify"] == "auto";
+        if (!automatic)
+        {
+            vector<string> names = tools.split(mapArgv["-stratify"], ",");
+            for (unsigned int i = 0; i < names.size(); i++)
+            {
+                tools.string_replace(names[i], " ", "");
+                int v = model.getVariableX(names[i]);
+                if (find(s->betas.begin(), s->betas.end(), v) == s->betas.end())
+                    Tools::fail("Error: " + names[i] + " is not a beta variable.");
+                variables.push_back(v);
+            }
+        }
+
+        // the pilot run chooses the strata and their allocation
+        vector<vector<int> > results, group;
+        if (automatic || allocation == "neyman")
+        {
+            int pilot = count(mapArgv, "-pilot", 1000, 2);
+            results.assign(pilot, vector<int>());
+            group.assign(pilot, vector<int>(model.variable_num, 0));
+#pragma omp parallel
+            {
+                Sampler S = model;
+                S.setStorage(Sampler::STORE_NONE);
+                vector<interface> I1 = properties;
+#pragma omp for schedule(dynamic)
+                for (int i = 0; i < pilot; i++)
+                {
+                    S.reset(PILOT + i);
+                    S.resetBeta();
+                    results[i] = interface::checkmodel(S, I1, propFolder, PILOT + i, vector<bool>(I1.size(), true));
+                    for (unsigned int b = 0; b < s->betas.size(); b++)
+                        group[i][s->betas[b]] = s->group(s->betas[b], S.betaDraw(s->betas[b]));
+                }
+            }
+        }
+
+        if (automatic)
+        {
+            // the variance between the groups of a variable, summed over the
+            // properties
+            int k = count(mapArgv, "-stratavariables", 2, 1);
+            vector<pair<double, int> > explained;
+            for (unsigned int b = 0; b < s->betas.size(); b++)
+            {
+                int v = s->betas[b];
+                double between = 0;
+                for (unsigned int p = 0; p < properties.size(); p++)
+                {
+                    vector<double> n(s->groups(v), 0), x(s->groups(v), 0);
+                    double mean = 0;
+                    for (unsigned int i = 0; i < results.size(); i++)
+                    {
+                        n[group[i][v]]++;
+                        x[group[i][v]] += results[i][p];
+                        mean += results[i][p];
+                    }
+                    mean /= results.size();
+                    for (int j = 0; j < s->groups(v); j++)
+                    {
+                        if (n[j] > 0)
+                            between += n[j] / results.size() * pow(x[j] / n[j] - mean, 2);
+                    }
+                }
+                explained.push_back(make_pair(-between, v));
+            }
+            sort(explained.begin(), explained.end());
+            for (int i = 0; i < k && i < explained.size() && explained[i].first < 0; i++)
+                variables.push_back(explained[i].second);
+            if (variables.empty())
+                Tools::fail("Error: no beta variable changes the results of the pilot traces, nothing to stratify.");
+        }
+        s->stratify(variables);
+
+        if (allocation == "neyman")
+        {
+            // shares proportional to the weight of a stratum times the
+            // standard deviation of its results in the pilot, the mean of
+            // their variances over the properties
+            unsigned int numprops = properties.size();
+            vector<double> n(s->count(), 0), x(s->count() * numprops, 0);
+            for (unsigned int i = 0; i < results.size(); i++)
+            {
+                int h = s->of(group[i]);
+                n[h]++;
+                for (unsigned int p = 0; p < numprops; p++)
+                    x[h * numprops + p] += results[i][p];
+            }
+            vector<double> share(s->count(), 0);
+            for (int h = 0; h < s->count(); h++)
+            {
+                double var = 0;
+                for (unsigned int p = 0; p < numprops; p++)
+                {
+                    double q = (x[h * numprops + p] + 1) / (n[h] + 2);
+                    var += q * (1 - q) / numprops;
+                }
+                share[h] = s->weights[h] * sqrt(var);
+            }
+            s->allocate(share);
+        }
+        strata = s;
+        model.strata = s;
+
+        cout << "Stratified sampling over";
+        for (unsigned int i = 0; i < variables.size(); i++)
+            cout << (i == 0 ? " " : ", ") << model.model->cpd_order[variables[i]];
+        cout << ": " << s->count() << " strata, " << allocation << " allocation." << endl;
+    }
+
+    // the proposal of -proposal <file>|ce: read from file (see Proposal), or
+    // tuned to the first property by the cross-entropy method, over at most
+    // -ceiterations <k> (10) rounds of -pilot <n> (1000) traces. Every round
+    // keeps the -cerho <rho> (0.1) of its traces of best score (see
+    // readScore), or all the ones that satisfy the property once they are
+    // as many, and moves the shifts and powers of the variables of -tilt
+    // <variables> (all by default) to the maximum likelihood of the ones
+    // kept, weighted by their likelihood ratios
+    void setProposal(map<string, string> &mapArgv, vector<interface> &properties)
+    {
+        Tools tools;
+        if (model.sampler_type != 1)
+            Tools::fail("Error: -proposal needs a DBN.");
+        if (mapArgv["-antithetic"] == "true" || mapArgv["-control"] != "" || mapArgv["-stratify"] != "" ||
+            mapArgv["-sampling"] == "qmc")
+            Tools::fail("Error: -proposal does not combine with -antithetic, -control, -stratify or -sampling qmc.");
+        shared_ptr<Proposal> q = make_shared<Proposal>(*model.model);
+        if (mapArgv["-proposal"] != "ce")
+            q->read(mapArgv["-proposal"], *model.model);
+        else
+            tuneProposal(mapArgv, properties[0], *q);
+        weighted = true;
+        model.proposal = q;
+        cout << "Importance sampling, proposal:" << endl;
+        q->print(cout, *model.model);
+    }
+
+    void tuneProposal(map<string, string> &mapArgv, interface &property, Proposal &q)
+    {
+        Tools tools;
+        int pilot = count(mapArgv, "-pilot", 1000, 10);
+        int rounds = count(mapArgv, "-ceiterations", 10, 1);
+        double rho = 0.1;
+        if (mapArgv["-cerho"] != "")
+        {
+            rho = atof(mapArgv["-cerho"].c_str());
+            if (rho <= 0 || rho >= 1)
+                Tools::fail("Error: -cerho is in (0, 1).");
+        }
+        Splitting::Score score = readScore(mapArgv, *model.model, property);
+        vector<bool> tilted(model.variable_num, mapArgv["-tilt"] == "");
+        vector<string> names = tools.split(mapArgv["-tilt"], ",");
+        for (unsigned int i = 0; i < names.size() && mapArgv["-tilt"] != ""; i++)
+        {
+            tools.string_replace(names[i], " ", "");
+            if (model.model->variableIndex.count(names[i]) == 0)
+                Tools::fail("Error: unknown variable of -tilt: " + names[i] + ".");
+            int v = model.model->variableIndex.find(names[i])->second;
+            if (!q.noisy[v] && !q.beta[v])
+                Tools::fail("Error: " + names[i] + " is neither a noisy variable nor a beta variable.");
+            tilted[v] = true;
+        }
+
+        // round t draws the pilot traces PILOT + t * 2^32 + i
+        bool reached = false;
+        for (int t = 0; t < rounds && !reached; t++)
+        {
+            vector<double> best(pilot), logWeight(pilot);
+            vector<vector<double> > sum(pilot), draws(pilot), logU(pilot);
+            Sampler tuned = model;
+            tuned.proposal = make_shared<Proposal>(q);
+#pragma omp parallel
+            {
+                Sampler S = tuned;
+                S.setStorage(Sampler::STORE_NONE);
+                S.tiltSums = true;
+#pragma omp for schedule(dynamic)
+                for (int i = 0; i < pilot; i++)
+                {
+                    S.reset(PILOT + ((uint64_t)t << 32) + i);
+                    S.resetBeta();
+                    best[i] = Splitting::best(S, property.formula, score);
+                    logWeight[i] = S.logWeight;
+                    sum[i] = S.normalSum;
+                    draws[i] = S.normalCount;
+                    logU[i].assign(model.variable_num, 0);
+                    for (int v = 0; v < model.variable_num; v++)
+                    {
+                        if (q.beta[v])
+                            logU[i][v] = log(S.betaDraw(v));
+                    }
+                }
+            }
 
+            // the level of the round, +infinity once rho of the traces
+            // satisfy the property
+            vector<double> sorted = best;
+            sort(sorted.begin(), sorted.end());
+            double level = sorted[min(pilot - 1, int((1 - rho) * pilot))];
+            reached = level == numeric_limits<double>::infinity();
+            double most = -numeric_limits<double>::infinity();
+            int kept = 0;
+            for (int i = 0; i < pilot; i++)
+            {
+                if (best[i] >= level)
+                {
+                    most = max(most, logWeight[i]);
+                    kept++;
+                }
+            }
+            vector<double> wz(model.variable_num, 0), wn(model.variable_num, 0), wlog(model.variable_num, 0);
+            double W = 0;
+            for (int i = 0; i < pilot; i++)
+            {
+                if (best[i] < level)
+                    continue;
+                double w = exp(logWeight[i] - most);
+                W += w;
+                for (int v = 0; v < model.variable_num; v++)
+                {
+                    wz[v] += w * sum[i][v];
+                    wn[v] += w * draws[i][v];
+                    wlog[v] += w * logU[i][v];
+                }
+            }
+            for (int v = 0; v < model.variable_num; v++)
+            {
+                if (!tilted[v])
+                    continue;
+                if (q.noisy[v] && wn[v] > 0)
+                    q.shift[v] = wz[v] / wn[v];
+                if (q.beta[v] && wlog[v] < 0)
+                    q.power[v] = -W / wlog[v];
+            }
+            cout << "Cross-entropy round " << t + 1 << ": level " << level << ", " << kept << " traces kept." << endl;
+        }
+        if (!reached)
+            cout << "The proposal does not reach the property after " << rounds << " rounds of cross-entropy." << endl;
+    }
+};
+// reads the test file: one test object per specification, initialized
+vector<Test *> readTests(string testfile)
+{
     vector<string> lines; // variables for string processing
     string line, keyword;
 
     vector<Test *> myTests; // list of tests to perform
-    /*
-    if (argc != 7 && argc != 9)
-    {
-        cout << tools.USAGE << endl;
-        cout << "Compiled for OpenMP. Maximum number of threads: " << omp_get_max_threads() << endl
-             << endl;
-        exit(EXIT_FAILURE);
-    }
-    */
-    /** for first argument - testing file **/
+
     // read test input file line by line
-    ifstream input(mapArgv["-testfile"]);
+    ifstream input(testfile);
     if (!input.is_open())
     {
-        cerr << "Error: cannot open testfile: " << mapArgv["-testfile"] << endl;
-        exit(EXIT_FAILURE);
+        Tools::fail("Error: cannot open testfile: " + testfile);
     }
     while (getline(input, line))
         lines.push_back(line);
@@ -1010,21 +2758,60 @@ void SMC(map<string, string> mapArgv)
                 myTests.push_back(new NSAM(lines[i]));
             else
             {
-                cerr << "Test unknown: " << lines[i] << endl;
-                exit(EXIT_FAILURE);
+                Tools::fail("Test unknown: " + lines[i]);
             }
 
-            myTests[numtests]->init(); // initializes the object
-            numtests++;
+            myTests.back()->init(); // initializes the object
         }
     }
+    return myTests;
+}
+void SMC(map<string, string> mapArgv)
+{
+    cout << "This is a paralleled version." << endl;
+    //cout << mapArgv["-testfile"] << endl;
+    //cout << mapArgv["-modelfile"] << endl;
+    //cout << mapArgv["-propfile"] << endl;
 
-    if (numtests == 0)
+    bool alldone = true; // all tests done
+    /*
+    if (argc != 7 && argc != 9)
+    {
+        cout << tools.USAGE << endl;
+        cout << "Compiled for OpenMP. Maximum number of threads: " << omp_get_max_threads() << endl
+             << endl;
+        exit(EXIT_FAILURE);
+    }
+    */
+    // every formula of the property files is checked on the same traces with
+    // its own copy of the tests; sampling goes on while one of them is not
+    // decided
+    vector<interface> properties = interface::readProperties(mapArgv["-propfile"]);
+    unsigned int numprops = properties.size();
+
+    /** for first argument - testing file **/
+    vector<vector<Test *> > myTests(numprops); // list of tests to perform, per property
+    for (unsigned int k = 0; k < numprops; k++)
+        myTests[k] = readTests(mapArgv["-testfile"]);
+
+    if (myTests[0].size() == 0)
     {
         cout << "No test requested - exiting ..." << endl;
         exit(EXIT_SUCCESS);
     }
 
+    vector<unsigned long int> satnum(numprops, 0); // number of sat samples
+    vector<unsigned long int> totnum(numprops, 0); // number of total samples
+    vector<atomic<bool> > decided(numprops);       // all tests of the property done
+    vector<string> label(numprops, "");            // printed before the results
+    vector<Randomizations> randomized(numprops);   // -sampling qmc
+    for (unsigned int k = 0; k < numprops; k++)
+    {
+        decided[k].store(false);
+        if (numprops > 1)
+            label[k] = "Property " + to_string(k + 1) + ": " + properties[k].formulaText;
+    }
+
     // timing stuff
     time_t start = time(NULL);
     clock_t tic = clock();
@@ -1035,132 +2822,242 @@ void SMC(map<string, string> mapArgv)
     // get the maximum number of threads
     int maxthreads = omp_get_max_threads();
 
-    // record trace checking result for each thread
-    vector<int> result(maxthreads, 0);
+    // trace checking results of a round
+    vector<vector<int> > result;
+
+    // -checkpoint <file>: the state of the run is saved there every
+    // -checkpointperiod seconds and at the end, -resume <file> continues the
+    // run saved in file (and keeps checkpointing to it)
+    string checkpointFile = mapArgv["-checkpoint"];
+    if (checkpointFile == "")
+        checkpointFile = mapArgv["-resume"];
+    double period = 60;
+    if (mapArgv["-checkpointperiod"] != "")
+    {
+        period = atof(mapArgv["-checkpointperiod"].c_str());
+        if (period <= 0)
+        {
+            cerr << "Error: the checkpoint period must be a positive number of seconds." << endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    Checkpoint checkpoint(checkpointFile, period);
+
     char str_temp[20] = "../trace";
     creatFolder("../trace");
-    string folderName = getmodelfilename("../trace", "SMC_wm");
-    creatFolder(folderName);
-    creatFolder(folderName + "/SAT");
-    creatFolder(folderName + "/UNSAT");
+    string folderName;
     int numTrace = 0;
-#pragma omp parallel num_threads(maxthreads) shared(result, alldone, numTrace)
+    if (mapArgv["-resume"] != "")
     {
-        // @Ziqiang, make sure that TC will return 1 if the trace checkers says unsat, and 0 otherwise
-        int ret; // code returned by trace checker
-
-        int tid = omp_get_thread_num();
-
-        // check whether we got all the threads requested
-        if (tid == 0)
+        checkpoint.load(mapArgv["-resume"], myTests);
+        folderName = checkpoint.folder;
+        numTrace = checkpoint.next;
+        totnum = checkpoint.totnum;
+        satnum = checkpoint.satnum;
+        cout << "Resumed from checkpoint " << mapArgv["-resume"] << " after " << numTrace << " traces." << endl;
+        for (unsigned int k = 0; k < numprops; k++)
         {
-            if (maxthreads != omp_get_num_threads())
+            bool done = true;
+            for (unsigned int j = 0; j < myTests[k].size(); j++)
             {
-                cerr << "Error: cannot use maximum number of threads" << endl;
-                exit(EXIT_FAILURE);
+                if (myTests[k][j]->done())
+                {
+                    if (label[k] != "")
+                        cout << label[k] << endl;
+                    myTests[k][j]->printResult();
+                }
+                done = done && myTests[k][j]->done();
             }
+            decided[k].store(done);
+            alldone = alldone && done;
         }
+    }
+    else
+    {
+        folderName = getmodelfilename("../trace", "SMC_wm");
+        alldone = false;
+    }
+    creatFolder(folderName);
 
-        // @Ziqiang, this is the first place to fill after you modify the ``bound'' input parameter
-        // My suggestion is that you may want to add a function in the trace checker that, once it takes
-        // in a BLTL, parse the formula and compute the bound in the way that I mention in the wechat.
-
-        // build the command line to call sampler_and_tracechecker (I will call it as TC in the following)
-        std::string TCpath = "./Check "; // the path to the exectuable binary of TC, not visible for users
-        //std::string callTC = TCpath + string(argv[2]) + " " + string(argv[3]) + " " + folderName; // only model and property are inputs for TC
-        std::string callTC = TCpath + mapArgv["-modelfile"] + " " + mapArgv["-propfile"] + " " + folderName;
-        if (mapArgv["-interfile"] != "")
-            callTC += " " + mapArgv["-interfile"];
-        if (mapArgv["-initfile"] != "")
-            callTC += " " + mapArgv["-initfile"];
-        else
-            callTC += " ../testcase/bmi_config.txt";
-
-        ofstream infofile(folderName + "/INFO");
-        infofile << "testfile: " << mapArgv["-testfile"] << endl;
-        infofile << "modelfile: " << mapArgv["-modelfile"] << endl;
-        infofile << "propfile: " << mapArgv["-propfile"] << endl;
-        infofile.close();
-        //cout<<callTC<<endl;
-        while (!alldone)
+    // -coordinator <address>: the traces come from ./SMC_wm -worker processes
+    string coordinator = mapArgv["-coordinator"];
+    unsigned long int netbatch = 64;
+    if (mapArgv["-netbatch"] != "")
+    {
+        netbatch = strtoul(mapArgv["-netbatch"].c_str(), NULL, 10);
+        if (netbatch == 0)
         {
-            string callTC_temp = callTC + " " + to_string(numTrace);
-            //cout<<callTC<<endl;
+            cerr << "Error: the batch size of the workers must be a positive integer." << endl;
+            exit(EXIT_FAILURE);
+        }
+    }
 
-            numTrace += 1;
-            // call TC
-            /**/
-            FILE *fp;
-            fp = popen(callTC_temp.c_str(), "r");
-            char result_buf[MAXLINE], command[MAXLINE];
-            int rc = 0;
-            if (NULL == fp)
-            {
-                cerr << "Error: system() call to the trace checker terminated abnormally: " << callTC_temp << endl;
-                exit(EXIT_FAILURE);
-            }
-            while (fgets(result_buf, sizeof(result_buf), fp) != NULL)
+    // generates and checks the traces, unless they come from workers
+    TraceChecker tc(mapArgv, properties, folderName, coordinator == "");
+
+    ofstream infofile(folderName + "/INFO");
+    infofile << "testfile: " << mapArgv["-testfile"] << endl;
+    infofile << "modelfile: " << mapArgv["-modelfile"] << endl;
+    infofile << "propfile: " << mapArgv["-propfile"] << endl;
+    if (numprops > 1)
+    {
+        for (unsigned int k = 0; k < numprops; k++)
+            infofile << "P" << k + 1 << ": " << properties[k].formulaText << endl;
+    }
+    infofile.close();
+
+    // generates trace traceIndex and checks it against the properties not
+    // decided yet
+    auto checkTrace = [&](vector<interface> &I1, int traceIndex) -> vector<int> {
+        vector<bool> active(numprops);
+        for (unsigned int k = 0; k < numprops; k++)
+            active[k] = !decided[k].load();
+        return tc.check(I1, traceIndex, active);
+    };
+    auto checkTraces = [&](vector<interface> &I1, int first, int count) -> vector<vector<int> > {
+        vector<bool> active(numprops);
+        for (unsigned int k = 0; k < numprops; k++)
+            active[k] = !decided[k].load();
+        return tc.check(I1, first, count, active);
+    };
+
+    // -antithetic, -control, -stratify: the observations the estimation
+    // tests are decided on, per property
+    vector<Observations> observations(numprops, tc.observations());
+    for (unsigned int k = 0; k < numprops && k < checkpoint.observations.size(); k++)
+    {
+        istringstream in(checkpoint.observations[k]);
+        if (checkpoint.observations[k] != "")
+            observations[k].load(in);
+    }
+
+    // saves the state of the run, the traces before next are all accounted
+    auto saveCheckpoint = [&](unsigned long int next) {
+        checkpoint.folder = folderName;
+        checkpoint.next = next;
+        checkpoint.totnum = totnum;
+        checkpoint.satnum = satnum;
+        checkpoint.observations.assign(numprops, "");
+        for (unsigned int k = 0; k < numprops && observations[k].on(); k++)
+        {
+            ostringstream out;
+            observations[k].save(out);
+            checkpoint.observations[k] = out.str();
+        }
+        checkpoint.save(mapArgv, myTests);
+    };
+
+    // accounts the results r of the next trace, returns whether all the properties are decided
+    unsigned long int accounted = numTrace;
+    auto account = [&](const vector<int> &r) -> bool {
+        bool all = true;
+        double g = tc.controlled ? tc.control(accounted) : 0;
+        double w = tc.weighted ? tc.weight(accounted) : 1;
+        int h = tc.stratum(accounted);
+        for (unsigned int k = 0; k < numprops; k++)
+        {
+            // a property still undecided was checked on every trace counted
+            if (!decided[k].load() && r[k] != -1)
             {
+                // update the num of sat samples and total samples
+                totnum[k] += 1;
+                satnum[k] += r[k];
+                randomized[k].add(accounted, r[k]);
+                observations[k].add(accounted, r[k], g, h, w);
+                if (doTests(myTests[k], totnum[k], satnum[k], label[k], true, &randomized[k], &observations[k]))
+                    decided[k].store(true);
             }
-            ret = pclose(fp);
-            //cout<<ret<<endl;
-            if (ret != 0 && ret != 256)
+            all = all && decided[k].load();
+        }
+        accounted++;
+        if (checkpoint.due())
+            saveCheckpoint(accounted);
+        if (progress.due())
+            progress.report(myTests, totnum, satnum);
+        return all;
+    };
+
+    if (coordinator != "" && !alldone)
+    {
+        // what the workers need to draw and check the same traces
+        vector<string> config;
+        for (map<string, string>::iterator it = mapArgv.begin(); it != mapArgv.end(); it++)
+        {
+            if (it->second != "" && it->first != "-coordinator" && it->first != "-resume" && it->first.compare(0, 11, "-checkpoint") != 0)
+                config.push_back("ARG " + it->first + " " + it->second);
+        }
+        config.push_back("SEED " + to_string(RandomStream::getSeed()));
+        config.push_back("FOLDER " + folderName);
+        config.push_back("END");
+        coordinate(coordinator, config, accounted, netbatch, decided, account);
+    }
+    else if (asyncMode && !alldone)
+    {
+        vector<vector<interface> > checkers(maxthreads, properties);
+        runAsync(
+            maxthreads,
+            [&](int tid, unsigned long ticket) { return checkTrace(checkers[tid], ticket); },
+            account, accounted);
+    }
+    else if (!asyncMode && coordinator == "")
+    {
+    // every round, thread tid checks the batchSize traces that follow
+    // numTrace + tid * batchSize; the master then accounts the traces of the
+    // round in their order and stops at the one that decides the tests, so
+    // the batches do not change when they stop
+    unsigned long int round = (unsigned long int)maxthreads * batchSize;
+    result.assign(round, vector<int>());
+#pragma omp parallel num_threads(maxthreads) shared(result, alldone, numTrace, tc, properties)
+    {
+        int tid = omp_get_thread_num();
+
+        // check whether we got all the threads requested
+        if (tid == 0)
+        {
+            if (maxthreads != omp_get_num_threads())
             {
-                cerr << "Error: system() call to the trace checker unsuccessful: " << callTC_temp << endl;
+                cerr << "Error: cannot use maximum number of threads" << endl;
                 exit(EXIT_FAILURE);
             }
-            ret = WEXITSTATUS(ret);
-            //cout<<ret<<"***"<<endl;
-            if (ret == 1)
-            {
-                result[tid] = 1;
-            }
-            else if (ret == 0)
-            {
-                result[tid] = 0;
-            }
-            else
+        }
+
+        vector<interface> I1 = properties;
+        while (!alldone)
+        {
+            // by groups of lanes traces drawn side by side
+            for (unsigned int i = 0; i < batchSize; i += lanes)
             {
-                cerr << "Error: system() call to the trace checker unsuccessful: " << endl;
-                exit(EXIT_FAILURE);
+                unsigned long int slot = tid * batchSize + i;
+                vector<vector<int> > r = checkTraces(I1, numTrace + slot, min(lanes, batchSize - i));
+                for (unsigned int j = 0; j < r.size(); j++)
+                    result[slot + j] = r[j];
             }
 
 #pragma omp barrier
             // only the master thread executes this
             if (tid == 0)
             {
-                // update the num of sat samples and total samples
-                totnum += maxthreads;
-                satnum += accumulate(result.begin(), result.end(), 0);
-                result.assign(maxthreads, 0);
-
-                // do all the tests
-                alldone = true;
-                for (unsigned int j = 0; j < numtests; j++)
-                {
-
-                    // do a test, if not done
-                    done = myTests[j]->done();
-                    if (!done)
-                    {
-                        myTests[j]->doTest(totnum, satnum);
-                        done = myTests[j]->done();
-                        if (done)
-                            myTests[j]->printResult();
-                    }
-                    alldone = alldone && done;
-                }
+                // update the num of sat samples and total samples, per
+                // property, and do all the tests
+                for (unsigned long int slot = 0; slot < round && !alldone; slot++)
+                    alldone = account(result[slot]);
+                numTrace += round;
             }
 #pragma omp barrier
         } //loop
 
     } // pragma parallel declaration
-    if (mapArgv["-getstruct"] == "true")
+    }
+    if (checkpointFile != "")
+        saveCheckpoint(accounted);
+    if (progress.on())
+        progress.report(myTests, totnum, satnum);
+    for (unsigned int k = 0; k < numprops && mapArgv["-getstruct"] == "true"; k++)
     {
         vector<string> satmodelfiles;
-        string satFolder = folderName + "/SAT";
+        string satFolder = tc.propFolder[k] + "/SAT";
         getFiles(satmodelfiles, satFolder, "trace");
-        ModelSearch MS(folderName);
+        ModelSearch MS(tc.propFolder[k]);
         MS.getStruct("../tetrad/trace.txt");
         MS.readstruct();
         for (int i = 0; i < satmodelfiles.size(); i++)
@@ -1187,9 +3084,429 @@ void SMC(map<string, string> mapArgv)
     cout << "Elapsed wall time: " << (time(NULL) - start) << endl;
     exit(EXIT_SUCCESS);
 }
-double getSampleResult(Sampler s, string v, int n, bool r)
+// Worker of a distributed run: connects to the coordinator at -worker
+// <address>, loads the run it is sent, then generates and checks the
+// batches of traces it is handed with all its threads until it is told to
+// stop. The traces are saved under the run folder of the coordinator, which
+// is shared when the nodes share a file system.
+void SMCWorker(map<string, string> mapArgv)
+{
+    Connection coordinator = Connection::connectTo(mapArgv["-worker"]);
+    map<string, string> runArgv;
+    string line, keyword, key, value, folderName;
+    while (coordinator.readLine(line) && line != "END")
+    {
+        istringstream iline(line);
+        iline >> keyword;
+        if (keyword == "ARG")
+        {
+            iline >> key;
+            value = "";
+            getline(iline >> ws, value);
+            runArgv[key] = value;
+        }
+        else if (keyword == "SEED")
+        {
+            uint64_t seed;
+            iline >> seed;
+            RandomStream::setSeed(seed);
+        }
+        else if (keyword == "FOLDER")
+            getline(iline >> ws, folderName);
+    }
+    if (line != "END")
+    {
+        cerr << "Error: lost the coordinator " << mapArgv["-worker"] << endl;
+        exit(EXIT_FAILURE);
+    }
+    useSampling(runArgv);
+    vector<interface> properties = interface::readProperties(runArgv["-propfile"]);
+    unsigned int numprops = properties.size();
+    TraceChecker tc(runArgv, properties, folderName, true);
+
+    omp_set_dynamic(0);
+    int maxthreads = omp_get_max_threads();
+    cout << "Worker of " << mapArgv["-worker"] << ": " << maxthreads << " threads, random seed " << RandomStream::getSeed() << endl;
+    vector<vector<interface> > checkers(maxthreads, properties);
+    unsigned long int traces = 0;
+    while (coordinator.readLine(line))
+    {
+        istringstream iline(line);
+        iline >> keyword;
+        if (keyword == "STOP")
+            break;
+        if (keyword != "BATCH")
+            continue;
+        unsigned long first, count;
+        string mask;
+        iline >> first >> count >> mask;
+        vector<bool> active(numprops);
+        for (unsigned int k = 0; k < numprops; k++)
+            active[k] = (mask[k] == '1');
+
+        // one character per trace: '1' sat, '0' unsat, '-' not checked
+        vector<string> r(numprops, string(count, '-'));
+        unsigned long int steps = Profiler::totals().steps;
+#pragma omp parallel for schedule(dynamic) num_threads(maxthreads)
+        for (long j = 0; j < (long)count; j += lanes)
+        {
+            vector<vector<int> > res = tc.check(checkers[omp_get_thread_num()], first + j, min((long)lanes, (long)count - j), active);
+            for (unsigned int i = 0; i < res.size(); i++)
+            {
+                for (unsigned int k = 0; k < numprops; k++)
+                {
+                    if (res[i][k] != -1)
+                        r[k][j + i] = '0' + res[i][k];
+                }
+            }
+        }
+        ostringstream out;
+        out << "RESULT " << first << " " << count << " " << Profiler::totals().steps - steps;
+        for (unsigned int k = 0; k < numprops; k++)
+            out << " " << r[k];
+        if (!coordinator.writeLine(out.str()))
+            break;
+        traces += count;
+    }
+    coordinator.close();
+    cout << "Worker done: " << traces << " traces." << endl;
+    exit(EXIT_SUCCESS);
+}
+// One job of a batch: a property checking run of its own, set up like
+// SMC() does, whose traces are generated by the threads of the batch along
+// with the traces of the other jobs.
+struct BatchJob
+{
+    string name;
+    map<string, string> args;
+    string error; // why the job cannot run, "" if it can
+    vector<interface> properties;
+    vector<vector<Test *> > myTests; // per property
+    vector<unsigned long int> totnum, satnum;
+    vector<atomic<bool> > decided;
+    vector<string> label;
+    vector<Randomizations> randomized; // -sampling qmc
+    vector<Observations> observations; // -antithetic, -control, -stratify
+    string folder;
+    TraceChecker *tc;
+    vector<vector<interface> > checkers; // per thread
+    SampleWindow<vector<int> > *window;
+    mutex consumer;       // held by the thread accounting the results
+    atomic<bool> stop;    // all the properties are decided
+    unsigned long int accounted;
+    double start;
+
+    BatchJob() : tc(NULL), window(NULL), stop(false), accounted(0), start(0)
+    {
+    }
+
+    // accounts the results r of the next trace, returns whether all the
+    // properties are decided
+    bool account(const vector<int> &r)
+    {
+        bool all = true;
+        double g = tc->controlled ? tc->control(accounted) : 0;
+        double w = tc->weighted ? tc->weight(accounted) : 1;
+        int h = tc->stratum(accounted);
+        for (unsigned int k = 0; k < properties.size(); k++)
+        {
+            if (!decided[k].load() && r[k] != -1)
+            {
+                totnum[k] += 1;
+                satnum[k] += r[k];
+                randomized[k].add(accounted, r[k]);
+                observations[k].add(accounted, r[k], g, h, w);
+                if (doTests(myTests[k], totnum[k], satnum[k], label[k], false, &randomized[k], &observations[k]))
+                    decided[k].store(true);
+            }
+            all = all && decided[k].load();
+        }
+        accounted++;
+        return all;
+    }
+
+    vector<int> check(int tid, unsigned long ticket)
+    {
+        vector<bool> active(properties.size());
+        for (unsigned int k = 0; k < properties.size(); k++)
+            active[k] = !decided[k].load();
+        return tc->check(checkers[tid], ticket, active);
+    }
+};
+
+static string jsonString(string s)
+{
+    string out = "\"";
+    for (unsigned int i = 0; i < s.size(); i++)
+    {
+        if (s[i] == '"' || s[i] == '\\')
+            out += '\\';
+        if (s[i] == '\n' || s[i] == '\t' || s[i] == '\r')
+            out += ' ';
+        else
+            out += s[i];
+    }
+    return out + "\"";
+}
+
+// the result record of a job, one JSON object
+string batchRecord(BatchJob &job)
+{
+    ostringstream js;
+    js << setprecision(10) << "{\"job\":" << jsonString(job.name);
+    if (job.error != "")
+    {
+        js << ",\"status\":\"error\",\"error\":" << jsonString(job.error) << "}";
+        return js.str();
+    }
+    js << ",\"status\":\"ok\",\"modelfile\":" << jsonString(job.args["-modelfile"])
+       << ",\"propfile\":" << jsonString(job.args["-propfile"]) << ",\"testfile\":" << jsonString(job.args["-testfile"])
+       << ",\"folder\":" << jsonString(job.folder) << ",\"traces\":" << job.accounted
+       << ",\"elapsed\":" << Profiler::now() - job.start << ",\"tests\":[";
+    bool first = true;
+    for (unsigned int k = 0; k < job.myTests.size(); k++)
+    {
+        for (unsigned int j = 0; j < job.myTests[k].size(); j++)
+        {
+            Test *T = job.myTests[k][j];
+            js << (first ? "" : ",") << "{\"property\":" << k + 1 << ",\"formula\":" << jsonString(job.properties[k].formulaText)
+               << ",\"test\":" << jsonString(T->getArgs()) << ",\"samples\":" << T->getSamples()
+               << ",\"successes\":" << T->getSuccesses();
+            if (T->verdict() != "")
+                js << ",\"accepted\":" << jsonString(T->verdict());
+            else
+                js << ",\"estimate\":" << T->getEstimate();
+            js << "}";
+            first = false;
+        }
+    }
+    js << "]}";
+    return js.str();
+}
+
+// Batch mode: runs the jobs of the manifest -batch <manifest> on one pool
+// of threads and writes one result record per job, as a JSON line, to
+// -batchresults <file> (<manifest>.results by default).
+//
+// A line of the manifest is a job: the arguments of a property checking
+// run, as on the command line, plus -name <name>. A job takes the arguments
+// of the batch it does not set. Lines that are empty or begin with '#' are
+// ignored. The jobs are set up one after the other, the jobs on the same
+// model, intervention and initial values share its loaded copy, and a job
+// that cannot be set up gets an error record without stopping the others.
+// Every thread then generates the next trace of the first job that can take
+// one, so the jobs finish about in the order of the manifest and no thread
+// idles while a job has traces left. Every job uses the seed of the batch
+// and accounts its traces in their order, so it gives the results of the
+// same run on its own with -async true.
+void SMCBatch(map<string, string> mapArgv)
+{
+    string manifest = mapArgv["-batch"];
+    string resultFile = mapArgv["-batchresults"];
+    if (resultFile == "")
+        resultFile = manifest + ".results";
+    ifstream input(manifest);
+    if (!input.is_open())
+    {
+        cerr << "Error: cannot open batch manifest: " << manifest << endl;
+        exit(EXIT_FAILURE);
+    }
+    ofstream results(resultFile);
+    if (!results.is_open())
+    {
+        cerr << "Error: cannot open batch results file: " << resultFile << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    omp_set_dynamic(0);
+    int maxthreads = omp_get_max_threads();
+    creatFolder("../trace");
+
+    // the arguments every job inherits
+    map<string, string> common = mapArgv;
+    common.erase("-batch");
+    common.erase("-batchresults");
+
+    vector<BatchJob *> jobs;
+    map<string, Sampler> models; // loaded models, by model, intervention and initial values
+    string line;
+    Tools::throwErrors = true;
+    while (getline(input, line))
+    {
+        istringstream iline(line);
+        vector<string> words;
+        string word;
+        while (iline >> word)
+            words.push_back(word);
+        if (words.size() == 0 || words[0].compare(0, 1, "#") == 0)
+            continue;
+        BatchJob *job = new BatchJob();
+        jobs.push_back(job);
+        job->name = "job" + to_string(jobs.size());
+        job->args = common;
+        try
+        {
+            if (words.size() % 2 != 0)
+                throw runtime_error("Error: a job needs a value after every option: " + line);
+            for (unsigned int i = 0; i < words.size(); i += 2)
+            {
+                if (words[i] == "-seed" || words[i] == "-batch" || words[i] == "-resume" ||
+                    words[i].compare(0, 11, "-checkpoint") == 0 || words[i] == "-coordinator" || words[i] == "-worker")
+                    throw runtime_error("Error: " + words[i] + " cannot be set for a job of a batch");
+                if (words[i] == "-name")
+                    job->name = words[i + 1];
+                else
+                    job->args[words[i]] = words[i + 1];
+            }
+            if (job->args["-getDistribution"] != "" || job->args["-tracesfile"] != "")
+                throw runtime_error("Error: a job of a batch can only check properties");
+            string files[3] = {job->args["-modelfile"], job->args["-interfile"], job->args["-initfile"]};
+            for (int f = 0; f < 3; f++)
+            {
+                if (files[f] != "" && !ifstream(files[f]).is_open())
+                    throw runtime_error("Error: cannot open " + files[f]);
+            }
+
+            job->properties = interface::readProperties(job->args["-propfile"]);
+            unsigned int numprops = job->properties.size();
+            job->myTests.assign(numprops, vector<Test *>());
+            for (unsigned int k = 0; k < numprops; k++)
+                job->myTests[k] = readTests(job->args["-testfile"]);
+            if (job->myTests[0].size() == 0)
+                throw runtime_error("No test requested");
+            job->totnum.assign(numprops, 0);
+            job->satnum.assign(numprops, 0);
+            job->decided = vector<atomic<bool> >(numprops);
+            job->label.assign(numprops, "");
+            job->randomized.assign(numprops, Randomizations());
+            for (unsigned int k = 0; k < numprops; k++)
+            {
+                job->decided[k].store(false);
+                if (numprops > 1)
+                    job->label[k] = "Property " + to_string(k + 1) + ": " + job->properties[k].formulaText;
+            }
+
+            string key = files[0] + "\n" + files[1] + "\n" + files[2];
+            if (models.count(key) == 0 && job->args["-engine"] != "check")
+            {
+                models[key] = Sampler(files[0], files[1]);
+                models[key].getInital(files[2]);
+            }
+            job->folder = getmodelfilename("../trace", "SMC_wm");
+            creatFolder(job->folder);
+            job->tc = new TraceChecker(job->args, job->properties, job->folder, true,
+                                       models.count(key) ? &models[key] : NULL);
+            job->observations.assign(numprops, job->tc->observations());
+            ofstream infofile(job->folder + "/INFO");
+            infofile << "job: " << job->name << endl;
+            infofile << "testfile: " << job->args["-testfile"] << endl;
+            infofile << "modelfile: " << job->args["-modelfile"] << endl;
+            infofile << "propfile: " << job->args["-propfile"] << endl;
+            infofile.close();
+            job->checkers.assign(maxthreads, job->properties);
+            job->window = new SampleWindow<vector<int> >(64 * (unsigned long)maxthreads, 0);
+        }
+        catch (runtime_error &e)
+        {
+            job->error = e.what();
+        }
+    }
+    Tools::throwErrors = false;
+
+    mutex outputMutex; // the results of a job are printed together
+    unsigned int failed = 0;
+    atomic<int> open(0);
+    for (unsigned int j = 0; j < jobs.size(); j++)
+    {
+        if (jobs[j]->error != "")
+        {
+            cout << "Job " << jobs[j]->name << ": " << jobs[j]->error << endl;
+            results << batchRecord(*jobs[j]) << endl;
+            failed++;
+        }
+        else
+            open++;
+    }
+    cout << "Batch of " << jobs.size() << " jobs on " << maxthreads << " threads." << endl;
+
+    // prints the results of a job that just finished and writes its record
+    auto finish = [&](BatchJob &job) {
+        lock_guard<mutex> lock(outputMutex);
+        cout << "Job " << job.name << ": " << job.folder << endl;
+        for (unsigned int k = 0; k < job.myTests.size(); k++)
+        {
+            if (job.label[k] != "")
+                cout << job.label[k] << endl;
+            for (unsigned int j = 0; j < job.myTests[k].size(); j++)
+                job.myTests[k][j]->printResult();
+        }
+        results << batchRecord(job) << endl;
+    };
+
+    time_t start = time(NULL);
+    double now = Profiler::now();
+    for (unsigned int j = 0; j < jobs.size(); j++)
+        jobs[j]->start = now;
+#pragma omp parallel num_threads(maxthreads)
+    {
+        int tid = omp_get_thread_num();
+        while (open.load() > 0)
+        {
+            bool worked = false;
+            for (unsigned int j = 0; j < jobs.size() && !worked; j++)
+            {
+                BatchJob &job = *jobs[j];
+                if (job.error != "" || job.stop.load())
+                    continue;
+
+                // any thread accounts the results of a job, one at a time
+                if (job.consumer.try_lock())
+                {
+                    vector<int> r;
+                    while (!job.stop.load() && job.window->pop(r))
+                    {
+                        if (job.account(r))
+                        {
+                            job.stop.store(true);
+                            finish(job);
+                            open--;
+                        }
+                    }
+                    job.consumer.unlock();
+                    if (job.stop.load())
+                        continue;
+                }
+                unsigned long ticket;
+                if (job.window->take(ticket))
+                {
+                    job.window->publish(ticket, job.check(tid, ticket));
+                    worked = true;
+                }
+            }
+            if (!worked)
+                sched_yield();
+        }
+    }
+    for (unsigned int j = 0; j < jobs.size(); j++)
+    {
+        delete jobs[j]->tc;
+        delete jobs[j]->window;
+        delete jobs[j];
+    }
+    results.close();
+    cout << "Batch done: " << jobs.size() - failed << " jobs finished, " << failed << " failed, results in "
+         << resultFile << endl;
+    cout << "Elapsed wall time: " << (time(NULL) - start) << endl;
+    exit(failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+// draws trace of s, started over, up to step n of v and returns it
+double getSampleResult(Sampler &s, string v, int n, bool r, unsigned long trace)
 {
+    Profiler::addTraces(1, n);
     double result;
+    // only step n of v is read: the backward sampling records its first step twice
+    s.setStorage(n >= 0 ? 1 : 2, vector<int>(1, s.getVariableX(v)));
+    s.reset(trace);
     if (r == 1)
         s.resetBeta();
     if(n>=0)
@@ -1250,28 +3567,85 @@ bool judgeResult(double r, string op, double n)
     else
         return 0;
 }
-double check(Sampler s, string v, int n, vector<string> op, vector<double> x)
+// the estimate of the probability that v at step n satisfies all the
+// comparisons op[i] x[i], with -sampling qmc the half-width of its interval
+// over the randomizations in halfWidth
+double check(Sampler &s, string v, int n, vector<string> op, vector<double> x, double *halfWidth = NULL)
 {
     //cout << "This is a paralleled version." << endl;
 
     bool alldone = false; // all tests done
-    bool done;
     unsigned long int satnum = 0; // number of sat samples
     unsigned long int totnum = 0; // number of total samples
     unsigned int numtests = 0;    // number of tests to perform
     double checkResult = 0;
-    Test *myTests = new BayesEstim("BEST 0.02 0.99 1 1"); //test to perform
+    Estim *myTests = new BayesEstim("BEST 0.02 0.99 1 1"); //test to perform
     myTests->init();
+    Randomizations randomized;
+    Observations observations(RandomStream::getAntithetic(), false, 0);
     omp_set_dynamic(0);
 
     // get the maximum number of threads
     int maxthreads = omp_get_max_threads();
 
-    // record trace checking result for each thread
-    vector<int> result(maxthreads, 0);
-#pragma omp parallel num_threads(maxthreads) shared(result, alldone, checkResult)
+    // whether sample trace of v, drawn in thread tid, satisfies all the conditions
+    vector<Sampler> states(maxthreads, s);
+    auto sample = [&](int tid, unsigned long trace) {
+        int isSat = 1;
+        double r = getSampleResult(states[tid], v, n, 1, trace);
+        for (int j = 0; j < op.size(); j++)
+        {
+            bool tempR = judgeResult(r, op[j], x[j]);
+            if (tempR == 0)
+                isSat = 0;
+        }
+        return isSat;
+    };
+
+    // accounts the next sample, returns whether the test is done
+    auto account = [&](int r) {
+        randomized.add(totnum, r);
+        observations.add(totnum, r, 0);
+        totnum += 1;
+        satnum += r;
+        {
+            ProfileScope scope(Profiler::TEST);
+            if (observations.on())
+                myTests->doReducedTest(observations, totnum, satnum);
+            else if (randomized.n.size() > 1)
+                myTests->doRandomizedTest(randomized, totnum, satnum);
+            else
+                myTests->doTest(totnum, satnum);
+        }
+        if (myTests->done())
+        {
+            checkResult = myTests->getEstimate();
+            myTests->setRandomized(randomized);
+            if (halfWidth != NULL)
+                *halfWidth = myTests->getHalfWidth();
+        }
+        if (progress.due())
+        {
+            vector<Test *> t(1, myTests);
+            progress.report(t, totnum, satnum);
+        }
+        return myTests->done();
+    };
+
+    if (asyncMode)
+    {
+        runAsync(
+            maxthreads, [&](int tid, unsigned long ticket) { return sample(tid, ticket); }, account);
+        return checkResult;
+    }
+
+    // every round, thread tid draws the batchSize samples that follow
+    // numTrace + tid * batchSize, and the master accounts them in their order
+    unsigned long round = (unsigned long)maxthreads * batchSize;
+    vector<int> result(round, 0);
+    unsigned long numTrace = 0;
+#pragma omp parallel num_threads(maxthreads) shared(result, alldone, checkResult, numTrace)
     {
-        int ret; // code returned by trace checker
         int tid = omp_get_thread_num();
         // check whether we got all the threads requested
         if (tid == 0)
@@ -1284,38 +3658,20 @@ double check(Sampler s, string v, int n, vector<string> op, vector<double> x)
         }
         while (!alldone)
         {
-            int isSat = 1;
-            for (int j = 0; j < op.size(); j++)
+            for (unsigned int i = 0; i < batchSize; i++)
             {
-                bool tempR = judgeResult(getSampleResult(s, v, n, 1), op[j], x[j]);
-                if (tempR == 0)
-                    isSat = 0;
+                unsigned long slot = tid * batchSize + i;
+                result[slot] = sample(tid, numTrace + slot);
             }
-            result[tid] = isSat;
 #pragma omp barrier
             // only the master thread executes this
             if (tid == 0)
             {
-                // update the num of sat samples and total samples
-                totnum += maxthreads;
-                satnum += accumulate(result.begin(), result.end(), 0);
-                result.assign(maxthreads, 0);
-
-                // do all the tests
-                alldone = true;
-                // do a test, if not done
-                done = myTests->done();
-                if (!done)
-                {
-                    myTests->doTest(totnum, satnum);
-                    done = myTests->done();
-                    if (done)
-                    {
-                        //myTests->printResult();
-                        checkResult = myTests->getEstimate();
-                    }
-                }
-                alldone = alldone && done;
+                // update the num of sat samples and total samples, and do
+                // the test up to the sample that decides it
+                for (unsigned long slot = 0; slot < round && !alldone; slot++)
+                    alldone = account(result[slot]);
+                numTrace += round;
             }
 #pragma omp barrier
         }
@@ -1324,44 +3680,48 @@ double check(Sampler s, string v, int n, vector<string> op, vector<double> x)
     //cout << "Number of threads: " << maxthreads << endl;
     return checkResult;
 }
+// s on a copy of its model without noise, the beta variables at their mean
 Sampler getSamplerWithoutRandomness(Sampler s)
 {
-    for (int i = 0; i < s.net_DBN.cpd_list.size(); i++)
+    shared_ptr<Model> model = make_shared<Model>(*s.model);
+    for (int i = 0; i < model->net_DBN.cpd_list.size(); i++)
     {
-        if (s.net_DBN.cpd_list[i].cpd_type == 1)
+        if (model->net_DBN.cpd_list[i].cpd_type == 1)
         {
-            s.net_DBN.cpd_list[i].var = 0;
-            for (int j = 0; j < s.net_DBN.cpd_list[i].intervention.size(); j++)
+            model->net_DBN.cpd_list[i].var = 0;
+            for (int j = 0; j < model->net_DBN.cpd_list[i].intervention.size(); j++)
             {
-                s.net_DBN.cpd_list[i].intervention[j].var = 0;
+                model->net_DBN.cpd_list[i].intervention[j].var = 0;
             }
         }
-        else if (s.net_DBN.cpd_list[i].cpd_type == 2)
+        else if (model->net_DBN.cpd_list[i].cpd_type == 2)
         {
-            s.value[s.NOW][i] = s.net_DBN.cpd_list[i].betaExpexted;
+            s.value[s.NOW][i] = s.start[i] = model->net_DBN.cpd_list[i].betaExpexted;
             //cout<<s.net_DBN.cpd_list[i].betaExpexted<<endl;
         }
     }
+    s.model = model;
+    s.native = NULL; // compiled from the model with noise
     return s;
 }
-double getV1(Sampler s, string v, double e, int n)
+double getV1(Sampler &s, string v, double e, int n)
 {
     int index = s.getVariableX(v);
-    if (s.net_DBN.cpd_list[index].cpd_type == 1)
+    if (s.model->net_DBN.cpd_list[index].cpd_type == 1)
     {
-        return s.net_DBN.cpd_list[index].intervention[0].var;
+        return s.model->net_DBN.cpd_list[index].intervention[0].var;
     }
     else if (abs(e) > 3)
         return e / 3;
     else
         return 1;
 }
-double getV2(Sampler s, string v, double e, int n)
+double getV2(Sampler &s, string v, double e, int n)
 {
     vector<double> r;
     for (int i = 0; i < 100; i++)
     {
-        r.push_back(getSampleResult(s, v, n, 1));
+        r.push_back(getSampleResult(s, v, n, 1, i));
     }
     Tools t;
     double var = sqrt(t.getVar(r));
@@ -1404,7 +3764,7 @@ void setInterval2(vector<double> &I, int n, double l, double r)
         I.push_back(temp);
     }
 }
-void getPorbDiscute(Sampler S, string v, int n, string output)
+void getPorbDiscute(Sampler &S, string v, int n, string output)
 {
     if (output == "")
         output = "../Distribution.txt";
@@ -1417,8 +3777,8 @@ void getPorbDiscute(Sampler S, string v, int n, string output)
     vector<double> D;
     double p;
     double sum = 0;
-    int index = S.net_BN.cpd_map[v];
-    for(int i=0;i<S.net_BN.cpd_list[index].variable_card;i++)
+    int index = S.getVariableX(v);
+    for(int i=0;i<S.model->net_BN.cpd_list[index].variable_card;i++)
     {
         cout <<"Calculating interal:"<< i << endl;
         vector<string> ops;
@@ -1431,12 +3791,15 @@ void getPorbDiscute(Sampler S, string v, int n, string output)
     }
     file_out << v << "[" << n << "]" << endl;
     file_out << "Interval   Estimated Probability   Normalized Probability" << endl;
-    for(int i=0;i<S.net_BN.cpd_list[index].variable_card;i++)
+    for(int i=0;i<S.model->net_BN.cpd_list[index].variable_card;i++)
     {
         file_out<<v<<"="<<i<<" "<<D[i]<<D[i]/sum<<endl;
     }
 }
-void getProb(vector<double> I, Sampler S, string v, int n, string output, int haveRange)
+// the probabilities of the intervals I of v at step n, estimated by sampling
+// or, given exact, computed from its distribution, with the half-widths of
+// the mixture when it mixes over draws of the beta variables
+void getProb(vector<double> I, Sampler &S, string v, int n, string output, int haveRange, LinearGaussian *exact = NULL)
 {
     if (output == "")
         output = "../Distribution.txt";
@@ -1447,7 +3810,11 @@ void getProb(vector<double> I, Sampler S, string v, int n, string output, int ha
         exit(EXIT_FAILURE);
     }
     vector<double> D;
-    double p;
+    vector<double> H; // -sampling qmc: the half-widths of the intervals of D
+    double p, h = -1;
+    auto check = [&](Sampler &S, string v, int n, vector<string> op, vector<double> x, double *h) {
+        return exact != NULL ? exact->probability(op, x, h) : ::check(S, v, n, op, x, h);
+    };
     if (haveRange == 0)
     {
         for (int i = 0; i < I.size() + 1; i++)
@@ -1459,8 +3826,9 @@ void getProb(vector<double> I, Sampler S, string v, int n, string output, int ha
             {
                 ops.push_back("<=");
                 conditions.push_back(I[0]);
-                p = check(S, v, n, ops, conditions);
+                p = check(S, v, n, ops, conditions, &h);
                 D.push_back(p);
+                H.push_back(h);
                 ops.clear();
                 conditions.clear();
                 //cout << v << " <= " << I[0] << "   Prob: " << p << endl;
@@ -1471,8 +3839,9 @@ void getProb(vector<double> I, Sampler S, string v, int n, string output, int ha
                 conditions.push_back(I[i - 1]);
                 ops.push_back("<=");
                 conditions.push_back(I[i]);
-                p = check(S, v, n, ops, conditions);
+                p = check(S, v, n, ops, conditions, &h);
                 D.push_back(p);
+                H.push_back(h);
                 ops.clear();
                 conditions.clear();
                 //cout << I[i - 1] << " < " << v << " <= " << I[i] << "   Prob: " << p << endl;
@@ -1481,8 +3850,9 @@ void getProb(vector<double> I, Sampler S, string v, int n, string output, int ha
             {
                 ops.push_back(">");
                 conditions.push_back(I[i - 1]);
-                p = check(S, v, n, ops, conditions);
+                p = check(S, v, n, ops, conditions, &h);
                 D.push_back(p);
+                H.push_back(h);
                 ops.clear();
                 conditions.clear();
                 //cout << v << " > " << I[i] << "   Prob: " << (now) << endl;
@@ -1501,8 +3871,9 @@ void getProb(vector<double> I, Sampler S, string v, int n, string output, int ha
                 conditions.push_back(I[i]);
                 ops.push_back("<=");
                 conditions.push_back(I[i + 1]);
-                p = check(S, v, n, ops, conditions);
+                p = check(S, v, n, ops, conditions, &h);
                 D.push_back(p);
+                H.push_back(h);
                 ops.clear();
                 conditions.clear();
             }
@@ -1512,8 +3883,9 @@ void getProb(vector<double> I, Sampler S, string v, int n, string output, int ha
                 conditions.push_back(I[i]);
                 ops.push_back("<=");
                 conditions.push_back(I[i + 1]);
-                p = check(S, v, n, ops, conditions);
+                p = check(S, v, n, ops, conditions, &h);
                 D.push_back(p);
+                H.push_back(h);
                 ops.clear();
                 conditions.clear();
             }
@@ -1524,31 +3896,56 @@ void getProb(vector<double> I, Sampler S, string v, int n, string output, int ha
     {
         sum += D[i];
     }
+    // -sampling qmc, -antithetic and a mixture over beta draws add the
+    // half-widths of the intervals of the estimates
+    bool randomized = exact == NULL ? RandomStream::getRandomizations() > 0 || RandomStream::getAntithetic()
+                                    : exact->mixture();
+    auto column = [&](int i) {
+        ostringstream out;
+        if (randomized)
+            out << "    " << H[i];
+        return out.str();
+    };
     file_out << v << "[" << n << "]" << endl;
-    file_out << "Interval   Estimated Probability   Normalized Probability" << endl;
+    file_out << "Interval   Estimated Probability   Normalized Probability" << (randomized ? "   Half-width" : "") << endl;
     for (int i = 0; i < D.size(); i++)
     {
         if (haveRange == 0)
         {
             if (i == 0)
-                file_out << "(-∞," << I[0] << "]    " << D[i] << "    " << D[i] / sum << endl;
+                file_out << "(-∞," << I[0] << "]    " << D[i] << "    " << D[i] / sum << column(i) << endl;
             else if (i != D.size() - 1)
-                file_out << "(" << I[i - 1] << "," << I[i] << "]    " << D[i] << "    " << D[i] / sum << endl;
+                file_out << "(" << I[i - 1] << "," << I[i] << "]    " << D[i] << "    " << D[i] / sum << column(i) << endl;
 
             else
-                file_out << "(" << I[i - 1] << ",+∞)        " << D[i] << "    " << D[i] / sum << endl;
+                file_out << "(" << I[i - 1] << ",+∞)        " << D[i] << "    " << D[i] / sum << column(i) << endl;
         }
         else
         {
             if (i == 0)
-                file_out << "[" << I[i] << "," << I[i + 1] << "]    " << D[i] << "    " << D[i] / sum << endl;
+                file_out << "[" << I[i] << "," << I[i + 1] << "]    " << D[i] << "    " << D[i] / sum << column(i) << endl;
             else
-                file_out << "(" << I[i] << "," << I[i + 1] << "]    " << D[i] << "    " << D[i] / sum << endl;
+                file_out << "(" << I[i] << "," << I[i + 1] << "]    " << D[i] << "    " << D[i] / sum << column(i) << endl;
         }
     }
+    if (exact != NULL)
+    {
+        double error;
+        double mean = exact->mean(&error);
+        file_out << "Mean: " << mean;
+        if (exact->mixture())
+            file_out << " +- " << error;
+        file_out << "   Standard deviation: " << exact->sd() << endl;
+        file_out << "Quantile   Value" << endl;
+        double q[] = {0.01, 0.05, 0.25, 0.5, 0.75, 0.95, 0.99};
+        for (int i = 0; i < 7; i++)
+            file_out << q[i] << "    " << exact->quantile(q[i]) << endl;
+    }
 }
 void getDistribution(map<string, string> mapArgv)
 {
+    if (mapArgv["-proposal"] != "")
+        Tools::fail("Error: -proposal is for the properties of -propfile.");
     cout << "This is a paralleled version." << endl;
     time_t start = time(NULL);
     clock_t tic = clock();
@@ -1598,15 +3995,52 @@ void getDistribution(map<string, string> mapArgv)
     if (sample1.sampler_type == 1)
     {
         sample1.getInital(initfile);
+        useNative(mapArgv, sample1);
+        // -exact true: a model that is linear-Gaussian once its beta
+        // variables are drawn gets its distribution in closed form, or with
+        // beta variables a mixture over -exactdraws draws of them, instead
+        // of sampling
+        LinearGaussian *exact = NULL;
+        if (mapArgv["-exact"] == "true" && targetTime > 0)
+        {
+            int draws = 1000;
+            if (mapArgv["-exactdraws"] != "")
+            {
+                if (!tools.isInt(mapArgv["-exactdraws"]) || tools.str2int(mapArgv["-exactdraws"]) <= 0)
+                    Tools::fail("Error: the number of draws must be a positive integer.");
+                draws = tools.str2int(mapArgv["-exactdraws"]);
+            }
+            exact = new LinearGaussian(sample1, targetVariable, targetTime, draws);
+            if (exact->linear && exact->mixture())
+                cout << "Linear-Gaussian model, approximated by a mixture over " << exact->means.size()
+                     << " draws of the beta variables." << endl;
+            else if (exact->linear)
+                cout << "Linear-Gaussian model, closed form." << endl;
+            else
+            {
+                cout << "Sampling, the model is not linear-Gaussian: " << exact->why << "." << endl;
+                delete exact;
+                exact = NULL;
+            }
+        }
         cout << "Getting interval information." << endl;
-        Sampler sample2 = getSamplerWithoutRandomness(sample1);
-        double E = getSampleResult(sample2, targetVariable, targetTime, 0);
-        double V = getV2(sample1, targetVariable, E, targetTime);
+        double E, V;
+        if (exact != NULL)
+        {
+            E = exact->mean();
+            V = exact->sd() < 2 ? 1 : exact->sd();
+        }
+        else
+        {
+            Sampler sample2 = getSamplerWithoutRandomness(sample1);
+            E = getSampleResult(sample2, targetVariable, targetTime, 0, 0);
+            V = getV2(sample1, targetVariable, E, targetTime);
+        }
         vector<double> Interval;
         int intervalNum = tools.str2int(mapArgv["-interval"]);
         int haveRange = 0;
         int vIndex = sample1.getVariableX(targetVariable);
-        if (sample1.net_DBN.cpd_list[vIndex].haveRange)
+        if (sample1.model->net_DBN.cpd_list[vIndex].haveRange)
             haveRange = 1;
         else
             haveRange = 0;
@@ -1616,9 +4050,10 @@ void getDistribution(map<string, string> mapArgv)
             setInterval(Interval, E, V, intervalNum);
         }
         else
-            setInterval2(Interval, intervalNum, sample1.net_DBN.cpd_list[vIndex].rangeL, sample1.net_DBN.cpd_list[vIndex].rangeR);
+            setInterval2(Interval, intervalNum, sample1.model->net_DBN.cpd_list[vIndex].rangeL, sample1.model->net_DBN.cpd_list[vIndex].rangeR);
         cout << "Checking..." << endl;
-        getProb(Interval, sample1, targetVariable, targetTime, outputfile, haveRange);
+        getProb(Interval, sample1, targetVariable, targetTime, outputfile, haveRange, exact);
+        delete exact;
     }
     else
     {
@@ -1637,7 +4072,6 @@ void SMC4BL(map<string, string> mapArgv)
     interface I(mapArgv["-propfile"]);
     cout << "This is a paralleled version." << endl;
     bool alldone = false; // all tests done
-    bool done;
     unsigned long int satnum = 0; // number of sat samples
     unsigned long int totnum = 0; // number of total samples
     unsigned int numtests = 0;    // number of tests to perform
@@ -1688,8 +4122,7 @@ void SMC4BL(map<string, string> mapArgv)
                 myTests.push_back(new NSAM(lines[i]));
             else
             {
-                cerr << "Test unknown: " << lines[i] << endl;
-                exit(EXIT_FAILURE);
+                Tools::fail("Test unknown: " + lines[i]);
             }
 
             myTests[numtests]->init(); // initializes the object
@@ -1716,6 +4149,46 @@ void SMC4BL(map<string, string> mapArgv)
     // record trace checking result for each thread
     vector<int> result(maxthreads, 0);
     int numTrace = 0;
+    if (asyncMode)
+    {
+        const int NOTRACE = 2; // the ticket is beyond the last trace of the file
+        runAsync(
+            maxthreads,
+            [&](int tid, unsigned long ticket) {
+                if (ticket >= b.sampleNum)
+                    return NOTRACE;
+                interface I1 = I;
+                ProfileScope scope(Profiler::CHECK);
+                Profiler::addTraces(1, b.traces[ticket].size());
+                int ret = I1.CheckBLTrace(b.varriableList, b.traces[ticket]);
+                if (ret != 1 && ret != 0)
+                {
+                    cerr << "Error: system() call to the trace checker unsuccessful: " << endl;
+                    exit(EXIT_FAILURE);
+                }
+                return ret;
+            },
+            [&](int r) {
+                if (r == NOTRACE)
+                {
+                    cerr << "Error: More traces is needed: " << endl;
+                    for (unsigned int j = 0; j < numtests; j++)
+                    {
+                        if (!myTests[j]->done())
+                        {
+                            myTests[j]->printResult();
+                        }
+                    }
+                    return true;
+                }
+                totnum += 1;
+                satnum += r;
+                if (progress.due())
+                    progress.report(myTests, totnum, satnum);
+                return doTests(myTests, totnum, satnum);
+            });
+    }
+    else
 #pragma omp parallel num_threads(maxthreads) shared(result, alldone, numTrace, I)
 {
         // @Ziqiang, make sure that TC will return 1 if the trace checkers says unsat, and 0 otherwise
@@ -1738,7 +4211,7 @@ void SMC4BL(map<string, string> mapArgv)
                 cerr << "Error: More traces is needed: " << endl;
                 for (unsigned int j = 0; j < numtests; j++)
                 {
-                    if (!done)
+                    if (!myTests[j]->done())
                     {
                         myTests[j]->printResult();
                     }
@@ -1746,7 +4219,11 @@ void SMC4BL(map<string, string> mapArgv)
                 break;
             }
             interface I1 = I;
-            ret = I1.CheckBLTrace(b.varriableList,b.traces[numTrace]);
+            {
+                ProfileScope scope(Profiler::CHECK);
+                Profiler::addTraces(1, b.traces[numTrace].size());
+                ret = I1.CheckBLTrace(b.varriableList,b.traces[numTrace]);
+            }
             numTrace += 1;
             if (ret == 1)
             {
@@ -1772,37 +4249,185 @@ void SMC4BL(map<string, string> mapArgv)
                 result.assign(maxthreads, 0);
 
                 // do all the tests
-                alldone = true;
-                for (unsigned int j = 0; j < numtests; j++)
-                {
-
-                    // do a test, if not done
-                    done = myTests[j]->done();
-                    if (!done)
-                    {
-                        myTests[j]->doTest(totnum, satnum);
-                        done = myTests[j]->done();
-                        if (done)
-                            myTests[j]->printResult();
-                    }
-                    alldone = alldone && done;
-                }
+                alldone = doTests(myTests, totnum, satnum);
+                if (progress.due())
+                    progress.report(myTests, totnum, satnum);
             }
 #pragma omp barrier
         } //loop
     } // pragma parallel declaration
+    if (progress.on())
+        progress.report(myTests, totnum, satnum);
     cout << "Number of processors: " << omp_get_num_procs() << endl;
     cout << "Number of threads: " << maxthreads << endl;
     cout << "Elapsed cpu time: " << (clock() - tic) / (double)(maxthreads * CLOCKS_PER_SEC) << endl;
     cout << "Elapsed wall time: " << (time(NULL) - start) << endl;
     exit(EXIT_SUCCESS);
 }
+// -splitting <particles>: estimates the probability of every property by
+// -splitruns <R> (10) independent runs of adaptive multilevel splitting,
+// the interval of the estimates from their spread. The score of the steps
+// is derived from the property, or the value of -score [-]<variable>
+void rareEvent(map<string, string> mapArgv)
+{
+    Tools tools;
+    if (!tools.isInt(mapArgv["-splitting"]) || tools.str2int(mapArgv["-splitting"]) < 2)
+        Tools::fail("Error: the number of particles must be an integer of at least 2.");
+    int particles = tools.str2int(mapArgv["-splitting"]);
+    int R = 10;
+    if (mapArgv["-splitruns"] != "")
+    {
+        if (!tools.isInt(mapArgv["-splitruns"]) || tools.str2int(mapArgv["-splitruns"]) < 2)
+            Tools::fail("Error: the number of runs must be an integer of at least 2.");
+        R = tools.str2int(mapArgv["-splitruns"]);
+    }
+    if (mapArgv["-sampling"] == "qmc" || mapArgv["-antithetic"] == "true" || mapArgv["-stratify"] != "" ||
+        mapArgv["-control"] != "" || mapArgv["-proposal"] != "")
+        Tools::fail("Error: -splitting does not combine with -sampling qmc, -antithetic, -stratify, -control or -proposal.");
+
+    vector<interface> properties = interface::readProperties(mapArgv["-propfile"]);
+    Sampler model(mapArgv["-modelfile"], mapArgv["-interfile"]);
+    model.getInital(mapArgv["-initfile"]);
+    if (model.sampler_type != 1)
+        Tools::fail("Error: -splitting needs a DBN.");
+    useNative(mapArgv, model);
+
+    vector<Splitting::Score> scores(properties.size());
+    for (unsigned int k = 0; k < properties.size(); k++)
+        scores[k] = readScore(mapArgv, *model.model, properties[k]);
+
+    time_t start = time(NULL);
+    cout << "Adaptive multilevel splitting, " << particles << " particles, " << R << " runs." << endl;
+    // the particles of run r draw their noise as the traces from
+    // 2^61 + r 2^40 on, apart from the ones of the sequential tests
+    const uint64_t SPLIT = 1ULL << 61;
+    for (unsigned int k = 0; k < properties.size(); k++)
+    {
+        vector<Splitting::Run> runs(R);
+#pragma omp parallel for schedule(dynamic)
+        for (int r = 0; r < R; r++)
+        {
+            Splitting splitting(model, properties[k].formula, scores[k], particles);
+            runs[r] = splitting.run(SPLIT + ((uint64_t)r << 40));
+        }
+        double mean = 0, var = 0, levels = 0, steps = 0;
+        for (int r = 0; r < R; r++)
+        {
+            mean += runs[r].estimate;
+            levels += runs[r].iterations;
+            steps += runs[r].steps;
+        }
+        mean /= R;
+        levels /= R;
+        for (int r = 0; r < R; r++)
+            var += pow(runs[r].estimate - mean, 2) / (R - 1);
+        double halfWidth = gsl_cdf_tdist_Pinv(0.975, R - 1) * sqrt(var / R);
+        if (properties.size() > 1)
+            cout << "Property " << k + 1 << ": " << properties[k].formulaText << endl;
+        cout << "Score: " << (scores[k].sign < 0 ? "-(" : "(") << model.model->cpd_order[scores[k].variable] << " - "
+             << scores[k].threshold << ")" << endl;
+        cout << "estimate = " << mean << ", 95% half-width = " << halfWidth << ", levels = " << levels
+             << ", steps = " << (unsigned long)steps << endl;
+    }
+    cout << "Number of threads: " << omp_get_max_threads() << endl;
+    cout << "Elapsed wall time: " << (time(NULL) - start) << endl;
+    exit(EXIT_SUCCESS);
+}
+// the summary of -profile true, at the exit of the run
+void printProfile()
+{
+    Profiler::printSummary(cout);
+}
 int main(int argc, char **argv)
 {
     Tools tools;
     map<string, string> mapArgv;
     mapArgv = tools.getArgvMap(argc, argv);
 
+    // a resumed run goes on with the arguments and the seed it was started with
+    if (mapArgv["-resume"] != "")
+        Checkpoint::loadArgs(mapArgv["-resume"], mapArgv);
+    asyncMode = (mapArgv["-async"] == "true");
+    if (mapArgv["-batchsize"] != "")
+    {
+        if (!tools.isInt(mapArgv["-batchsize"]) || atoi(mapArgv["-batchsize"].c_str()) <= 0)
+        {
+            cout << "Error: the batch size must be a positive integer." << endl;
+            exit(EXIT_FAILURE);
+        }
+        batchSize = atoi(mapArgv["-batchsize"].c_str());
+    }
+    if (mapArgv["-lanes"] != "")
+    {
+        if (!tools.isInt(mapArgv["-lanes"]) || atoi(mapArgv["-lanes"].c_str()) <= 0)
+        {
+            cout << "Error: the number of lanes must be a positive integer." << endl;
+            exit(EXIT_FAILURE);
+        }
+        lanes = atoi(mapArgv["-lanes"].c_str());
+        // a round gives every thread one group of lanes at least
+        if (mapArgv["-batchsize"] == "")
+            batchSize = lanes;
+    }
+
+    // -profile true: times every phase and prints a summary table at exit
+    if (mapArgv["-profile"] == "true")
+    {
+        Profiler::enabled = true;
+        atexit(printProfile);
+    }
+
+    // -progress <seconds>: periodic progress line, -progressjson <file>: the
+    // same reports as JSON lines, every 10 seconds by default
+    if (mapArgv["-progress"] != "" || mapArgv["-progressjson"] != "")
+    {
+        double period = 10;
+        if (mapArgv["-progress"] != "")
+            period = atof(mapArgv["-progress"].c_str());
+        if (period <= 0)
+        {
+            cout << "Error: the progress period must be a positive number of seconds." << endl;
+            exit(EXIT_FAILURE);
+        }
+        progress.open(period, mapArgv["-progressjson"]);
+    }
+
+    if (mapArgv["-native"] != "" && mapArgv["-native"] != "true" && mapArgv["-native"] != "false")
+    {
+        if (mapArgv["-native"] != "build")
+            Tools::fail("Error: -native is true, false or build.");
+        buildNative(mapArgv);
+    }
+
+    // a worker gets its run, seed included, from the coordinator
+    if (mapArgv["-worker"] != "")
+        SMCWorker(mapArgv);
+
+    // the same seed gives the same samples, whatever the number of threads
+    if (mapArgv["-seed"] != "")
+    {
+        if (!tools.isInt(mapArgv["-seed"]) || mapArgv["-seed"][0] == '-')
+        {
+            cout << "Error: the seed must be a non-negative integer." << endl;
+            exit(EXIT_FAILURE);
+        }
+        RandomStream::setSeed(strtoull(mapArgv["-seed"].c_str(), NULL, 10));
+    }
+    else
+    {
+        random_device rd;
+        RandomStream::setSeed(((uint64_t)rd() << 32) | rd());
+        mapArgv["-seed"] = to_string(RandomStream::getSeed());
+    }
+    cout << "Random seed: " << RandomStream::getSeed() << endl;
+    useSampling(mapArgv);
+
+    // -batch <manifest>: runs all the jobs of the manifest
+    if (mapArgv["-batch"] != "")
+        SMCBatch(mapArgv);
+
+    if (mapArgv["-modelfile"] != "" && mapArgv["-propfile"] != "" && mapArgv["-splitting"] != "")
+        rareEvent(mapArgv);
     if (mapArgv["-modelfile"] != ""&&mapArgv["-propfile"] != "")
     {
         SMC(mapArgv);
@@ -3,6 +3,14 @@ int main(int argc, char *argv[])
 {
     interface in;
 
+    // seed of the SMC_wm run this trace belongs to
+    if (getenv("SMC4WM_SEED") != NULL)
+        RandomStream::setSeed(strtoull(getenv("SMC4WM_SEED"), NULL, 10));
+    if (getenv("SMC4WM_RANDOMIZATIONS") != NULL)
+        RandomStream::setRandomizations(strtoul(getenv("SMC4WM_RANDOMIZATIONS"), NULL, 10));
+    if (getenv("SMC4WM_ANTITHETIC") != NULL)
+        RandomStream::setAntithetic(string(getenv("SMC4WM_ANTITHETIC")) == "1");
+
     char prop_file[] = "../testcase/prop";
     char model_file[] = "../testcase/cra_cag_praise_2019-02-03_01-14-16_histogram.dat";
     //char model_file[] = "../testcase/newmodel.txt";
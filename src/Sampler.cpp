@@ -1,108 +1,86 @@
 #include "Sampler.h"
+#include "Profiler.h"
 
 Sampler::Sampler()
 {
+	variable_num = 0;
+	controlRow = -1;
+	logWeight = 0;
+	tiltSums = false;
+	setStorage(STORE_ALL);
 }
 
-Sampler::Sampler(string filename, string interfile)
+Sampler::Sampler(string filename, string interfile) : model(make_shared<Model>(filename, interfile))
 {
 	this->NOW = 0;
 	this->NEXT = 1;
 	this->sample_size = 0;
-	sampler_type = judge_file_type(filename);
-	if (sampler_type == 1)
-	{
-		this->net_DBN.load_network(filename);
-		this->net_DBN.getIntervention(interfile);
-		this->variable_num = this->net_DBN.cpd_list.size();
-		for (int i = 0; i < this->variable_num; i++)
-		{
-			cpd_order.push_back(net_DBN.cpd_list[i].cpd_name);
-			if (this->net_DBN.cpd_list[i].cpd_type != 2)
-			{
-				string::size_type nPos2 = 0;
-				nPos2 = this->net_DBN.cpd_list[i].cpd_name.find("'", nPos2);
-				if (nPos2 != string::npos)
-				{
-					this->value[NOW][i] = 1.0;
-				}
-				else
-				{
-					this->value[NOW][i] = 1.0;
-				}
-				//cout << net_DBN.cpd_list[i].cpd_name << endl;
-			}
-			else
-			{
-				this->value[NOW][i] = get_beta_value(net_DBN.cpd_list[i].beta_v, net_DBN.cpd_list[i].beta_p);
-			}
-		}
-		setMatrix();
-		/*
-		for(int i=0;i<variable_num;i++)
-		    cout<<net_DBN.cpd_list[i].cpd_name<<" ";
-		cout<<endl;
-		for(int i=0;i<variable_num;i++)
-		{
-			for(int j=0;j<variable_num+1;j++)
-			    cout<<CM[i][j]<<" ";
-			cout<<endl;
-		}*/
-	}
-	else if (sampler_type == 0)
-	{
-
-		this->net_BN.readUAI(filename);
-		this->variable_num = this->net_BN.cpd_list.size();
-		for (int i = 0; i < this->variable_num; i++)
-		{
-			cpd_order.push_back(net_BN.cpd_list[i].cpd_name);
-			if (net_BN.cpd_list[i].cpd_type == 3)
-			{
-				this->value[NOW][i] = randomint(0, net_BN.cpd_list[i].variable_card);
-			}
-			else if (net_BN.cpd_list[i].cpd_type == 4)
-			{
-				this->value[NOW][i] = net_BN.cpd_list[i].weights[0];
-			}
-			evidence.insert(pair<string, double>(net_BN.cpd_list[i].cpd_name, value[NOW][i]));
-		}
-	}
+	sampler_type = model->sampler_type;
+	variable_num = model->variable_num;
+	start = model->initial;
+	value[0] = start;
+	value[1].assign(variable_num, 0);
+	cursor.assign(variable_num, 0);
+	for (int i = 0; i < variable_num && sampler_type == 0; i++)
+		evidence.insert(pair<string, double>(model->cpd_order[i], value[NOW][i]));
+	controlRow = -1;
+	logWeight = 0;
+	tiltSums = false;
+	setStorage(STORE_ALL);
 }
 
 void Sampler::get_one_sample()
 {
-	vector<double> one_sample;
+	ProfileScope scope(Profiler::SIMULATE);
 	if (sample_size == 0)
 	{
-		for (int i = 0; i < variable_num; i++)
-		{
-			one_sample.push_back(value[NOW][i]);
-		}
-		all_results.push_back(one_sample);
+		record(&value[NOW][0]);
 		sample_size++;
 	}
 	else
 	{
 		if (sampler_type == 1)
 		{
-			for (int i = 0; i < variable_num; i++)
-				flag[i] = 0;
-
-			for (int i = 0; i < variable_num; i++)
+			// the normal draws of the step, in bulk, before the values
+			int kind = model->kindAt(sample_size);
+			const vector<pair<int, int> > &runs = model->noise[kind];
+			noise.resize(variable_num);
+			for (int r = 0; r < runs.size(); r++)
+				rng.normals(runs[r].first, sample_size, runs[r].second, &noise[runs[r].first]);
+			if (proposal != NULL)
 			{
-				if (flag[i] == 1)
-					continue;
-				value[NEXT][i] = Calculate(i);
-				//cout<<value[NEXT][i]<<" ";
+				for (int r = 0; r < runs.size(); r++)
+				{
+					logWeight += proposal->tiltNormals(runs[r].first, runs[r].second, &noise[runs[r].first]);
+					for (int i = runs[r].first; i < runs[r].first + runs[r].second && tiltSums; i++)
+					{
+						normalSum[i] += noise[i];
+						normalCount[i]++;
+					}
+				}
+			}
+			if (native != NULL)
+			{
+				native->kernel(kind)(&value[NOW][0], &value[NEXT][0], &noise[0]);
+			}
+			else
+			{
+				// a single pass in the order of the schedule of this step
+				int s = upper_bound(model->breakpoints.begin(), model->breakpoints.end(), sample_size) - model->breakpoints.begin() - 1;
+				const vector<int> &order = model->schedule[s];
+				for (int j = 0; j < order.size(); j++)
+				{
+					int i = order[j];
+					value[NEXT][i] = Calculate(i);
+					//cout<<value[NEXT][i]<<" ";
+				}
 			}
 			//cout<<endl;
 			for (int i = 0; i < variable_num; i++)
 			{
-				one_sample.push_back(value[NEXT][i]);
-				if (!net_DBN.cpd_list[i].inRange(value[NEXT][i]))
+				if (!model->net_DBN.cpd_list[i].inRange(value[NEXT][i]))
 				{
-					cout << "Error: Varriable " << net_DBN.cpd_list[i].cpd_name << " = " << value[NEXT][i] << ", out of range." << endl;
+					cout << "Error: Varriable " << model->net_DBN.cpd_list[i].cpd_name << " = " << value[NEXT][i] << ", out of range." << endl;
 					exit(EXIT_FAILURE);
 				}
 			}
@@ -112,20 +90,24 @@ void Sampler::get_one_sample()
 		}
 		else if (sampler_type == 0)
 		{
+			noise.resize(variable_num);
+			uniforms.resize(variable_num);
+			rng.normals(0, sample_size, variable_num, &noise[0]);
+			rng.uniforms(0, sample_size, variable_num, &uniforms[0]);
 			for (int i = 0; i < variable_num; i++)
 			{
 				value[NOW][i] = Calculate(i);
-				one_sample.push_back(value[NOW][i]);
 			}
 		}
-		all_results.push_back(one_sample);
-		one_sample.clear();
+		record(&value[NOW][0]);
 		sample_size++;
 	}
 }
 
 double Sampler::Calculate(int cpd_index)
 {
+	const DBN &net_DBN = model->net_DBN;
+	const BN &net_BN = model->net_BN;
 	int type;
 	if (sampler_type == 0)
 		type = net_BN.cpd_list[cpd_index].cpd_type;
@@ -136,87 +118,64 @@ double Sampler::Calculate(int cpd_index)
 	{
 		if (type == 2)
 		{
-			flag[cpd_index] = 1;
 			return value[NOW][cpd_index];
 		}
-		stack<double> result;
-		int inter_index = -1;
-		for (int i = net_DBN.cpd_list[cpd_index].intervention.size() - 1; i >= 0; i--)
-		{
-			if (net_DBN.cpd_list[cpd_index].intervention[i].begin_t <= sample_size && (net_DBN.cpd_list[cpd_index].intervention[i].end_t > sample_size || net_DBN.cpd_list[cpd_index].intervention[i].end_t < 0))
-			{
-				inter_index = i;
-				net_DBN.cpd_list[cpd_index].cpd_type = net_DBN.cpd_list[cpd_index].intervention[i].func_type;
-				net_DBN.cpd_list[cpd_index].var = net_DBN.cpd_list[cpd_index].intervention[i].var;
-				break;
-			}
-		}
-		//cout<<"inter:"<<inter_index<<endl;
+		const Model::Segment &segment = model->segmentAt(cpd_index, sample_size, cursor[cpd_index]);
+		//cout<<"inter:"<<segment.operation<<endl;
 		//net_DBN.cpd_list[cpd_index].get_cpd_info();
-		if (inter_index == -1)
+		if (segment.operation == -1)
 		{
 			return value[NOW][cpd_index];
 		}
 
-		for (int i = 0; i < net_DBN.cpd_list[cpd_index].intervention[inter_index].Postfix.size(); i++)
+		// the compiled Postfix, on a stack of doubles
+		const CPD::Operation &operation = net_DBN.cpd_list[cpd_index].intervention[segment.operation];
+		double small[32];
+		vector<double> large;
+		double *result = small;
+		if (operation.depth > 32)
 		{
-			if (net_DBN.cpd_list[cpd_index].intervention[inter_index].Postfix[i].type == 0)
-			{
-				string var_name = net_DBN.cpd_list[cpd_index].intervention[inter_index].Postfix[i].name;
-				int temp_index;
-				string::size_type nPos2 = 0;
-				nPos2 = var_name.find("_next", nPos2);
-
-				if (nPos2 == string::npos)
-				{
-					//cout<<" 1 "<<var_name<<endl;
-					temp_index = getVariableX(var_name);
-					//cout<<"11"<<endl;
-					result.push(value[NOW][temp_index]);
-				}
-				else
-				{
-					string_replace(var_name, "_next", "");
-					//cout<<" 1"<<endl;
-					temp_index = getVariableX(var_name);
-					//cout<<"11"<<endl;
-					if (flag[temp_index] == 0)
-					{
-						result.push(Calculate(temp_index));
-					}
-					else
-					{
-						result.push(value[NEXT][temp_index]);
-					}
-				}
-			}
-			else if (net_DBN.cpd_list[cpd_index].intervention[inter_index].Postfix[i].type == 1)
-			{
-				result.push(net_DBN.cpd_list[cpd_index].intervention[inter_index].Postfix[i].value);
-			}
-			else
+			large.resize(operation.depth);
+			result = &large[0];
+		}
+		int top = 0;
+		for (int i = 0; i < operation.code.size(); i++)
+		{
+			const CPD::Instruction &ins = operation.code[i];
+			switch (ins.code)
 			{
-				double t_a = result.top();
-				result.pop();
-				double t_b = result.top();
-				result.pop();
-				double t_r = Execute(t_a, net_DBN.cpd_list[cpd_index].intervention[inter_index].Postfix[i].op, t_b);
-				result.push(t_r);
+			case CPD::Instruction::LOAD_NOW:
+				result[top++] = value[NOW][ins.slot];
+				break;
+			case CPD::Instruction::LOAD_NEXT:
+				// computed before, in the order of the schedule
+				result[top++] = value[NEXT][ins.slot];
+				break;
+			case CPD::Instruction::CONSTANT:
+				result[top++] = ins.value;
+				break;
+			case CPD::Instruction::APPLY:
+				top--;
+				result[top - 1] = Execute(result[top], ins.op, result[top - 1]);
+				break;
+			case CPD::Instruction::UNKNOWN:
+				getVariableX(operation.Postfix[i].name);
+				break;
 			}
 		}
-		flag[cpd_index] = 1;
+		double expression = result[top - 1];
 		//if(net_DBN.cpd_list[cpd_index].cpd_name == "intervention")cout<<result.top()<<" "<<type<<endl;
-		if (type == 0)
+		if (!(sample_size == segment.first ? segment.noiseFirst : segment.noise))
 		{
-			value[NEXT][cpd_index] = result.top();
-			return result.top();
+			value[NEXT][cpd_index] = expression;
+			return expression;
 		}
 		else
 		{
-			double rand = net_DBN.cpd_list[cpd_index].var * gaussrand();
-			value[NEXT][cpd_index] = result.top() + rand;
-			//cout << result.top() << " " << rand << endl;
-			return result.top() + rand;
+			double rand = operation.var * noise[cpd_index];
+			value[NEXT][cpd_index] = expression + rand;
+			//cout << expression << " " << rand << endl;
+			return expression + rand;
 		}
 	}
 	else if (type == 3)
@@ -242,68 +201,29 @@ double Sampler::Calculate(int cpd_index)
 		}
 		cout<<endl;
 		*/
-		return double(RandomChosse(possible_list));
+		return double(RandomChosse(possible_list, uniforms[cpd_index]));
 	}
 	else
 	{
 		double mean = net_BN.query_continuous_cpd(net_BN.cpd_list[cpd_index], evidence);
 		double var = net_BN.cpd_list[cpd_index].var;
-		return gaussrand() * var + mean;
+		return noise[cpd_index] * var + mean;
 	}
 }
 
-double Sampler::get_beta_value(vector<double> beta_value, vector<double> possiblelist)
-{
-	if (beta_value.size() != possiblelist.size() || beta_value.size() == 0)
-	{
-		cout << "Error: Wrong beta distribution input." << endl;
-		exit(EXIT_FAILURE);
-	}
-	//cout<<beta_value[0]<<" "<<possiblelist[0]<<endl;
-	double sumpossible = 0.0;
-	double randomfloatnum = randomfloat(0, 1);
-	int result;
-	for (int i = 0; i < possiblelist.size(); i++)
-	{
-		sumpossible += possiblelist[i];
-	}
-	randomfloatnum *= sumpossible;
-	for (int i = 0; i < possiblelist.size(); i++)
-	{
-		randomfloatnum -= possiblelist[i];
-		if (randomfloatnum < 0)
-		{
-			result = i;
-			break;
-		}
-		result = possiblelist.size() - 1;
-	}
-	double max = beta_value[result];
-	double min = beta_value[result - 1];
-	return randomfloat(min, max);
-}
 
-int Sampler::judge_file_type(string filename)
+void Sampler::saveSampleResult(string filename)
 {
-	ifstream fin(filename);
-	if (!fin)
-	{
-		cout << "Error: Wrong modelfile input." << endl;
-		exit(EXIT_FAILURE);
-		return 0;
-	}
-	string ss;
-	fin >> ss;
-	fin.close();
-	//cout << ss << endl;
-	if (ss == "BAYES")
-		return 0;
-	else
-		return 1;
+	saveSampleResult(filename, sample_size);
+	rows = 0;
 }
-void Sampler::saveSampleResult(string filename)
+void Sampler::saveSampleResult(string filename, int steps)
 {
+	ProfileScope scope(Profiler::SAVE);
+	if (!keeps(steps))
+		Tools::fail("Error: the sampler does not keep the steps of the trace to save in " + filename + ".");
 	ofstream file_out(filename);
+	const vector<string> &cpd_order = model->cpd_order;
 	for (int i = 0; i < cpd_order.size(); i++)
 	{
 		file_out << cpd_order[i];
@@ -311,14 +231,15 @@ void Sampler::saveSampleResult(string filename)
 			file_out << "\t";
 	}
 	file_out << endl;
-	for (int i = 0; i < sample_size; i++)
+	for (int i = 0; i < steps; i++)
 	{
+		const double *row = &history[(size_t)i * width];
 		for (int j = 0; j < cpd_order.size(); j++)
 		{
 
-			file_out << all_results[i][j];
-			//cout<< all_results[i][j]<<" ";
-			if ((all_results[i][j] - int(all_results[i][j])) == 0)
+			file_out << row[j];
+			//cout<< row[j]<<" ";
+			if ((row[j] - int(row[j])) == 0)
 				file_out << ".0";
 			if (j < cpd_order.size() - 1)
 				file_out << "\t";
@@ -327,7 +248,49 @@ void Sampler::saveSampleResult(string filename)
 		//cout<<endl;
 	}
 	file_out.close();
-	all_results.clear();
+}
+void Sampler::setStorage(int steps, vector<int> variables)
+{
+	storeSteps = steps;
+	storeVariables = variables;
+	width = variables.empty() ? variable_num : variables.size();
+	rows = 0;
+	history.clear();
+	// a ring of the last steps is allocated once, all the steps grow by doubling
+	if (storeSteps > 0)
+		history.assign((size_t)storeSteps * width, 0);
+}
+bool Sampler::keeps(int steps)
+{
+	return storeVariables.empty() && steps <= rows && (storeSteps == STORE_ALL || (storeSteps >= rows && steps <= storeSteps));
+}
+void Sampler::record(const double *row)
+{
+	if (rows == controlRow)
+		controlValue = row[controlVariable];
+	if (storeSteps != STORE_NONE)
+	{
+		size_t r = storeSteps == STORE_ALL ? rows : rows % storeSteps;
+		if ((r + 1) * width > history.size())
+			history.resize(max(2 * history.size(), (r + 1) * width));
+		double *to = &history[r * width];
+		if (storeVariables.empty())
+			copy(row, row + width, to);
+		for (int c = 0; c < storeVariables.size(); c++)
+			to[c] = row[storeVariables[c]];
+	}
+	rows++;
+}
+// the value of variable at row of the steps drawn, which must be kept
+double Sampler::stored(int row, int variable)
+{
+	int column = variable;
+	if (!storeVariables.empty())
+		column = find(storeVariables.begin(), storeVariables.end(), variable) - storeVariables.begin();
+	if (column == width || storeSteps == STORE_NONE || (storeSteps != STORE_ALL && row < rows - storeSteps))
+		Tools::fail("Error: the sampler does not keep step " + to_string(row + 1) + " of " + model->cpd_order[variable] + ".");
+	size_t r = storeSteps == STORE_ALL ? row : row % storeSteps;
+	return history[r * width + column];
 }
 void Sampler::checkSampleResult(string filename)
 {
@@ -359,7 +322,7 @@ void Sampler::getInital(string initfile)
 		nameStr = getNamefromInit(nameStr);
 		cpd_index = getVariableX(nameStr);
 		if (isDouble(num))
-			value[NOW][cpd_index] = atof(num.c_str());
+			value[NOW][cpd_index] = start[cpd_index] = atof(num.c_str());
 		else
 		{
 			cout << "Error: Wrong inital input." << endl;
@@ -398,125 +361,68 @@ string Sampler::getNamefromInit(string s)
 	//cout << r << endl;
 	return r;
 }
-int Sampler::getVariableX(string v)
-{
-	//cout<<v<<endl;
-	for (int i = 0; i < cpd_order.size(); i++)
-	{
-		if (v == cpd_order[i])
-		{
-			return i;
-		}
-	}
-	cout << "Error Variable doesn't exist." << endl;
-	cout << "\"" << v << "\"" << endl;
-	exit(EXIT_FAILURE);
-	return 0;
-}
 double Sampler::getResult(string v, int n)
 {
 	int X = getVariableX(v);
 	if(n<0)n=-n;
-	if (n < 1 || n > all_results.size())
+	if (n < 1 || n > rows)
 	{
 		cout << "Error: Wrong input number." << endl;
 		cout << USAGE << endl;
 		exit(EXIT_FAILURE);
 	}
-	return all_results[n - 1][X];
+	return stored(n - 1, X);
 }
 void Sampler::resetBeta()
 {
-	for (int i = 0; i < net_DBN.cpd_list.size(); i++)
+	// the uniform draws 0 of the beta variables, then their draws 1
+	const vector<pair<int, int> > &runs = model->betas;
+	uniforms.resize(2 * variable_num);
+	for (int r = 0; r < runs.size(); r++)
 	{
-		if (net_DBN.cpd_list[i].cpd_type == 2)
-		{
-			value[NOW][i] = get_beta_value(net_DBN.cpd_list[i].beta_v, net_DBN.cpd_list[i].beta_p);
-		}
+		rng.uniforms(runs[r].first, 0, runs[r].second, &uniforms[runs[r].first], 0);
+		rng.uniforms(runs[r].first, 0, runs[r].second, &uniforms[variable_num + runs[r].first], 1);
 	}
-}
-void Sampler::setMatrix()
-{
-	variable_num = net_DBN.cpd_list.size();
-	for (int i = 0; i < variable_num; i++)
+	if (strata != NULL)
+		strata->condition(rng.getTrace(), &uniforms[0]);
+	for (int r = 0; r < runs.size() && proposal != NULL; r++)
 	{
-		vector<double> tempd;
-		net_DBN.cpd_list[i].var = 0;
-		if(net_DBN.cpd_list[i].intervention.size()!=0)
-		    net_DBN.cpd_list[i].var = net_DBN.cpd_list[i].intervention[0].var;
-		var.push_back(net_DBN.cpd_list[i].var);
-		for (int j = 0; j < variable_num + 1; j++)
-		{
-			tempd.push_back(0);
-		}
-        CM.push_back(tempd);
-		if (net_DBN.cpd_list[i].cpd_type == 2||net_DBN.cpd_list[i].pns.size()==0)
-		{
-			net_DBN.cpd_list[i].setBetaPN();
-		}
-		flagLR[i] = 1;
-		int k = net_DBN.cpd_list[i].pns.size();
-		for(int j=0;j<k;j++)
-		{
-			string::size_type nPos1 = 0;
-	        nPos1 = net_DBN.cpd_list[i].pns[j].name.find("_next", nPos1);
-	        if (nPos1 == string::npos&&net_DBN.cpd_list[i].pns[j].type!=2)
-			{
-                flagLR[i] = 0;
-				//cout<<"type: "<<net_DBN.cpd_list[i].pns[j].type<<endl;
-				break;
-			}
-		}
-		//cout<<"flag:  "<<flagLR[i]<<endl;
+		for (int i = runs[r].first; i < runs[r].first + runs[r].second; i++)
+			logWeight += proposal->tiltUniform(i, uniforms[i]);
 	}
-	for (int i = 0; i < variable_num; i++)
+	for (int r = 0; r < runs.size(); r++)
 	{
-		int k = net_DBN.cpd_list[i].pns.size();
-		int j = 0;
-		if(flagLR[i]==1)
-		{
-            CM[i][i] = 1;
-			continue;
-		}
-		while (j < k)
-		{
-			//cout<<i<<" "<<j<<" "<<endl;
-			//cout<<net_DBN.cpd_list[i].cpd_name<<" "<<net_DBN.cpd_list[i].pns[j].name<<" "<<net_DBN.cpd_list[i].pns[j].type<<endl;
-			if(net_DBN.cpd_list[i].pns[j].type == 1)
-			{
-				int indt = getVariableX(net_DBN.cpd_list[i].pns[j].beta);
-				net_DBN.cpd_list[i].pns[j].c *= value[NOW][indt];
-			}
-			else if(net_DBN.cpd_list[i].pns[j].type == 2)
-			{
-                CM[i][variable_num] += net_DBN.cpd_list[i].pns[j].c;
-				j++;
-				continue;
-			}
-			string::size_type nPos1 = 0;
-	        nPos1 = net_DBN.cpd_list[i].pns[j].name.find("_next", nPos1);
-	        if (nPos1 != string::npos)
-			{
-				//cout<<"123"<<endl;
-				string_replace(net_DBN.cpd_list[i].pns[j].name,"_next","");
-				int indt = getVariableX(net_DBN.cpd_list[i].pns[j].name); 
-				//cout<<indt<<" "<< net_DBN.cpd_list[i].pns[i].name<<" "<<net_DBN.cpd_list[indt].pns.size()<<endl;
-				for(int ij = 0;ij<net_DBN.cpd_list[indt].pns.size();ij++)
-				{
-					net_DBN.cpd_list[indt].pns[ij].c *= net_DBN.cpd_list[i].pns[j].c;
-					net_DBN.cpd_list[i].pns.push_back(net_DBN.cpd_list[indt].pns[ij]);
-					k++;
-				}
-			}
-			else
-			{
-				int indt = getVariableX(net_DBN.cpd_list[i].pns[j].name);
-                CM[i][indt] += net_DBN.cpd_list[i].pns[j].c;
-                var[i] += net_DBN.cpd_list[i].pns[j].c * var[indt];
-			}
-			j++;		
-		}
+		for (int i = runs[r].first; i < runs[r].first + runs[r].second; i++)
+			value[NOW][i] = model->get_beta_value(i, uniforms[i], uniforms[variable_num + i]);
+	}
+}
+void Sampler::setTrace(unsigned long t)
+{
+	rng.setTrace(t);
+}
+void Sampler::reset(unsigned long t)
+{
+	rng.setTrace(t);
+	NOW = 0;
+	NEXT = 1;
+	sample_size = 0;
+	rows = 0;
+	copy(start.begin(), start.end(), value[NOW].begin());
+	fill(cursor.begin(), cursor.end(), 0);
+	logWeight = 0;
+	if (tiltSums)
+	{
+		normalSum.assign(variable_num, 0);
+		normalCount.assign(variable_num, 0);
 	}
+	for (int i = 0; i < variable_num && sampler_type == 0; i++)
+		evidence[model->cpd_order[i]] = model->initial[i];
+}
+void Sampler::restart(const double *row, int r, unsigned long t)
+{
+	reset(t);
+	copy(row, row + variable_num, value[NOW].begin());
+	sample_size = r + 1;
 }
 void Sampler::getBackwardSample()
 {
@@ -524,13 +430,24 @@ void Sampler::getBackwardSample()
 	vector<double> one_sample;
 	if (sample_size == 0)
 	{
-		LE.setCM(CM);
+		// the dense n x (n + 1) matrix only exists for the backward sampling
+		vector<vector<double> > dense(variable_num, vector<double>(variable_num + 1, 0));
+		for (int i = 0; i < variable_num; i++)
+		{
+			for (map<int, double>::const_iterator it = model->CM[i].begin(); it != model->CM[i].end(); it++)
+				dense[i][it->first] = it->second;
+		}
+		pns.resize(variable_num);
+		for (int i = 0; i < variable_num; i++)
+			pns[i] = model->net_DBN.cpd_list[i].pns;
+		var = model->var;
+		LE.setCM(dense);
 		LE.setVar(var);
 		for (int i = 0; i < variable_num; i++)
 		{
 			one_sample.push_back(value[NOW][i]);
 		}
-		all_results.push_back(one_sample);
+		record(&one_sample[0]);
 		sample_size++;
 	}
 	else
@@ -542,34 +459,36 @@ void Sampler::getBackwardSample()
 			//cout<<value[NOW][i]<<endl;
 		}
 		one_sample = LE.getResult(query);
+		noise.resize(variable_num);
+		rng.normals(0, sample_size, variable_num, &noise[0]);
 
         for(int i=0;i<variable_num;i++)
 		{
-			if(flagLR[i]==1)
+			if(model->flagLR[i]==1)
 			{
 				one_sample[i] = 0;
-				for(int j=0;j<net_DBN.cpd_list[i].pns.size();j++)
+				for(int j=0;j<pns[i].size();j++)
 				{
-					if(net_DBN.cpd_list[i].pns[j].type == 1)
+					if(pns[i][j].type == 1)
 			        {
-				        int indt = getVariableX(net_DBN.cpd_list[i].pns[j].beta);
-				        net_DBN.cpd_list[i].pns[j].c *= value[NOW][indt];
+				        int indt = getVariableX(pns[i][j].beta);
+				        pns[i][j].c *= value[NOW][indt];
 			        }
-					if(net_DBN.cpd_list[i].pns[j].type !=2)
+					if(pns[i][j].type !=2)
 					{
-						string temp = net_DBN.cpd_list[i].pns[j].name;
+						string temp = pns[i][j].name;
 						string_replace(temp,"_next","");
 						int indt = getVariableX(temp);
-                        one_sample[i] += net_DBN.cpd_list[i].pns[j].c * one_sample[indt];
-						var[i] += net_DBN.cpd_list[i].pns[j].c * var[indt];
+                        one_sample[i] += pns[i][j].c * one_sample[indt];
+						var[i] += pns[i][j].c * var[indt];
 					}
 					else
 					{
-						one_sample[i] += net_DBN.cpd_list[i].pns[j].c;
+						one_sample[i] += pns[i][j].c;
 					}
 				}
 			}
-			one_sample[i]+=var[i]*gaussrand();
+			one_sample[i]+=var[i]*noise[i];
 		}
 	}
 	for(int i=0;i<variable_num;i++)
@@ -578,7 +497,7 @@ void Sampler::getBackwardSample()
 			value[NOW][i] = one_sample[i];
 		}
 		//cout<<endl;
-	all_results.push_back(one_sample);
+	record(&one_sample[0]);
 		one_sample.clear();
 		sample_size++;
 }
\ No newline at end of file
@@ -1,46 +1,93 @@
 #pragma once
-#include"DBN.h"
-#include"BN.h"
-#include"CPD.h"
+#include"Model.h"
+#include"NativeModel.h"
 #include"linearEquation.h"
+#include"RandomStream.h"
+#include"Strata.h"
+#include"Proposal.h"
 #include<fstream>
+#include<memory>
+/**
+ * The state of one trace of a model: the values of this step and the next
+ * one, the step counter, the random stream and the steps kept. The model is
+ * shared by all the copies, so that copying a Sampler or starting it over
+ * with reset() costs O(variables).
+ */
 class Sampler :private Tools
 {
 public:
 	Sampler();
 	Sampler(string filename, string interfile);
+	shared_ptr<const Model> model;
+	shared_ptr<const NativeModel> native; // the steps compiled to native code, when loaded
+	shared_ptr<const Strata> strata;      // the beta variables are drawn in the stratum of the trace, when set
+	shared_ptr<const Proposal> proposal;  // the noise and the beta variables are drawn from it, when set
 	int NOW;
 	int NEXT;
 
-	DBN net_DBN;
-	BN net_BN;
-	int sampler_type; //0:BN  1:DBN
-	double value[2][1000];
+	int sampler_type; //0:BN  1:DBN, as the model
+	vector<double> value[2]; // this step and the next one, one slot per variable
+	vector<double> start;    // the values the traces start from
 	int variable_num;
 	void get_one_sample();
 	int sample_size;
-	vector<string>cpd_order;
 	void saveSampleResult(string);
+	void saveSampleResult(string, int); // first steps only, keeps the results
 	void getInital(string initfile);
 	double getResult(string v, int n);
-	int getVariableX(string v);
+	int getVariableX(string v) { return model->getVariableX(v); }
 	vector<double> getLikehood(vector<double>);
-	vector<vector<double> >all_results;
+	// what is kept of the steps drawn: the last steps (STORE_ALL, the
+	// default, or STORE_NONE) of the given variables (all when empty), in one
+	// contiguous buffer
+	static const int STORE_ALL = -1;
+	static const int STORE_NONE = 0;
+	void setStorage(int steps, vector<int> variables = vector<int>());
+	bool keeps(int steps); // whether the first steps are kept, all their variables
 	void getBackwardSample();
 	void getForwardSample();
 	void resetBeta();
-	void setMatrix();
+	void setTrace(unsigned long);
+	// back to the start of trace t, without allocating: the beta variables
+	// are the ones of start until resetBeta()
+	void reset(unsigned long t);
+	// continues a trace from row, the values of its step r: the steps after
+	// it draw their noise as the ones of trace t
+	void restart(const double *row, int r, unsigned long t);
+	RandomStream rng; // keyed by (trace, variable, step)
+	// the value of variable controlVariable at row controlRow of the steps
+	// drawn, kept whatever the storage (the control variate of -control),
+	// controlRow is -1 when none
+	int controlVariable, controlRow;
+	double controlValue;
+	// the uniform draw that picked the bin of beta variable v
+	double betaDraw(int v) const { return uniforms[v]; }
+	// with a proposal, the log of the likelihood ratio of the draws since
+	// reset(), nominal over proposal; with tiltSums, also the sum of the
+	// normal draws of every variable and their number
+	double logWeight;
+	bool tiltSums;
+	vector<double> normalSum, normalCount;
 private:
-	int flag[1000];
+	friend class BatchSampler;   // runs the compiled operations and the schedule on its lanes
+	friend class LinearGaussian; // and on affine forms
 	double Calculate(int cpd_index);
-    double get_beta_value(vector<double>, vector<double>);
-	int judge_file_type(string);
+	vector<int> cursor; // segment of every variable at the current step
+	vector<double> noise;    // the normal draws of a step, drawn in bulk
+	vector<double> uniforms; // its uniform draws, of a BN step or of the beta variables
 	map<string, double>evidence;
 	void checkSampleResult(string);
     string getNamefromInit(string);
-	vector<vector<double> > CM;
+	// the backward sampling rescales the coefficients of the model at every
+	// step, a trace does it on its own copy of them
+	vector<vector<CPD::parentNode> > pns;
 	vector<double>var;
     linearEquation LE;
-	int flagLR[1000];
+	vector<double> history;      // row r of the steps drawn at (r % storeSteps) * width, when kept
+	int storeSteps;              // rows kept, STORE_ALL or STORE_NONE
+	vector<int> storeVariables;  // variable of every column, all when empty
+	int width;                   // columns of a row
+	int rows;                    // rows recorded so far
+	void record(const double *row);
+	double stored(int row, int variable);
 };
-
@@ -0,0 +1,121 @@
+#include "Sobol.h"
+
+static uint64_t splitmix(uint64_t x)
+{
+	x += 0x9E3779B97F4A7C15ULL;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+	return x ^ (x >> 31);
+}
+// a * b modulo p, polynomials over GF(2) with p of degree s
+static uint32_t mulmod(uint32_t a, uint32_t b, uint32_t p, int s)
+{
+	uint32_t r = 0;
+	for (; b != 0; b >>= 1)
+	{
+		if (b & 1)
+			r ^= a;
+		a <<= 1;
+		if ((a >> s) & 1)
+			a ^= p;
+	}
+	return r;
+}
+static uint32_t powmod(uint32_t a, uint32_t e, uint32_t p, int s)
+{
+	uint32_t r = 1;
+	for (; e != 0; e >>= 1)
+	{
+		if (e & 1)
+			r = mulmod(r, a, p, s);
+		a = mulmod(a, a, p, s);
+	}
+	return r;
+}
+// whether x has order 2^s - 1 modulo p
+static bool primitive(uint32_t p, int s)
+{
+	uint32_t order = (1u << s) - 1;
+	uint32_t x = s == 1 ? 1 : 2;
+	if (powmod(x, order, p, s) != 1)
+		return false;
+	for (uint32_t q = 2, n = order; q <= n; q++)
+	{
+		if (n % q != 0)
+			continue;
+		if (powmod(x, order / q, p, s) == 1)
+			return false;
+		while (n % q == 0)
+			n /= q;
+	}
+	return true;
+}
+const std::vector<uint32_t> &Sobol::directions()
+{
+	static const std::vector<uint32_t> v = [] {
+		std::vector<uint32_t> v(32 * DIMENSIONS);
+		// dimension 0 is van der Corput's sequence
+		for (int b = 0; b < 32; b++)
+			v[b] = 1u << (31 - b);
+		int d = 1;
+		for (int s = 1; d < DIMENSIONS; s++)
+		{
+			for (uint32_t p = (1u << s) | 1; p < (2u << s) && d < DIMENSIONS; p += 2)
+			{
+				if (!primitive(p, s))
+					continue;
+				// m[k] odd and below 2^k, the recurrence of p past the
+				// first s of them
+				uint64_t m[33];
+				for (int k = 1; k <= 32; k++)
+				{
+					if (k <= s)
+					{
+						m[k] = (splitmix((uint64_t)d << 32 | k) & ((1ULL << k) - 1)) | 1;
+						continue;
+					}
+					m[k] = m[k - s] ^ (m[k - s] << s);
+					for (int j = 1; j < s; j++)
+					{
+						if ((p >> (s - j)) & 1)
+							m[k] ^= m[k - j] << j;
+					}
+				}
+				for (int k = 1; k <= 32; k++)
+					v[32 * d + k - 1] = (uint32_t)(m[k] << (32 - k));
+				d++;
+			}
+		}
+		return v;
+	}();
+	return v;
+}
+static uint32_t reverse(uint32_t x)
+{
+	x = ((x >> 1) & 0x55555555) | ((x & 0x55555555) << 1);
+	x = ((x >> 2) & 0x33333333) | ((x & 0x33333333) << 2);
+	x = ((x >> 4) & 0x0F0F0F0F) | ((x & 0x0F0F0F0F) << 4);
+	x = ((x >> 8) & 0x00FF00FF) | ((x & 0x00FF00FF) << 8);
+	return (x >> 16) | (x << 16);
+}
+double Sobol::point(uint32_t index, int dimension, uint64_t scramble)
+{
+	const uint32_t *v = &directions()[32 * dimension];
+	uint32_t x = 0;
+	for (int b = 0; index != 0; b++, index >>= 1)
+	{
+		if (index & 1)
+			x ^= v[b];
+	}
+	// on the reversed digits, a hash whose bit k only depends on the bits
+	// below k: a permutation of every digit given the ones above it
+	uint32_t seed = (uint32_t)splitmix(scramble);
+	x = reverse(x);
+	x ^= x * 0x3D20ADEA;
+	x += seed;
+	x *= (seed >> 16) | 1;
+	x ^= x * 0x05526C56;
+	x ^= x * 0x53A22864;
+	x = reverse(x);
+	return ((double)x + 0.5) * (1.0 / 4294967296.0);
+}
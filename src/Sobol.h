@@ -0,0 +1,26 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+/**
+ * Sobol' low-discrepancy sequence (Sobol', 1967), 32 bits per coordinate,
+ * with Owen's nested uniform scrambling hashed as in Burley (JCGT 2020):
+ * every scramble permutes the digits of a coordinate independently, so each
+ * scrambled point is uniform on the unit cube and the points of one scramble
+ * keep the stratification of the sequence.
+ *
+ * The direction numbers are built at first use from the primitive
+ * polynomials over GF(2), in increasing degree, with initial numbers drawn
+ * from a fixed hash rather than from an optimized table.
+ */
+class Sobol
+{
+public:
+	static const int DIMENSIONS = 1024;
+	// coordinate dimension (< DIMENSIONS) of point index, in (0, 1), under
+	// scramble
+	static double point(uint32_t index, int dimension, uint64_t scramble);
+
+private:
+	static const std::vector<uint32_t> &directions(); // 32 per dimension, from the most significant bit
+};
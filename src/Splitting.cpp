@@ -0,0 +1,200 @@
+#include "Splitting.h"
+#include "Profiler.h"
+#include <limits>
+
+// the value of an arithmetic node that is a constant, possibly negated
+static bool constant(Node *node, double &value)
+{
+	if (node == NULL || node->op_type != ARITHMETIC)
+		return false;
+	ArithmeticNode *a = (ArithmeticNode *)node;
+	if (a->a.op == NOOP_A && a->a.var == "")
+	{
+		value = a->a.val;
+		return true;
+	}
+	if (a->a.op == SUB_A && a->left == NULL && constant(a->right, value))
+	{
+		value = -value;
+		return true;
+	}
+	return false;
+}
+
+// the name of an arithmetic node that is a variable, "" otherwise
+static string variable(Node *node)
+{
+	if (node == NULL || node->op_type != ARITHMETIC)
+		return "";
+	ArithmeticNode *a = (ArithmeticNode *)node;
+	return a->a.op == NOOP_A ? a->a.var : "";
+}
+
+// the comparisons of a variable with a constant under node
+static void comparisons(Node *node, vector<Node *> &found)
+{
+	if (node == NULL || node->op_type != LOGICAL_RELATIONAL)
+		return;
+	opLogicalRelational op = ((LogicalRelationalNode *)node)->lr.op;
+	if (op == LT_R || op == LTE_R || op == GT_R || op == GTE_R)
+	{
+		double c;
+		if ((variable(node->left) != "" && constant(node->right, c)) || (constant(node->left, c) && variable(node->right) != ""))
+			found.push_back(node);
+		return;
+	}
+	comparisons(node->left, found);
+	comparisons(node->right, found);
+}
+
+bool Splitting::derive(Node *formula, const Model &model, Score &score, string &why)
+{
+	vector<Node *> found;
+	comparisons(formula, found);
+	if (found.size() != 1)
+	{
+		why = found.empty() ? "no comparison of a variable with a constant" : "several comparisons";
+		return false;
+	}
+	Node *node = found[0];
+	opLogicalRelational op = ((LogicalRelationalNode *)node)->lr.op;
+	bool left = variable(node->left) != "";
+	string name = left ? variable(node->left) : variable(node->right);
+	if (model.variableIndex.count(name) == 0)
+	{
+		why = "unknown variable " + name;
+		return false;
+	}
+	score.variable = model.variableIndex.find(name)->second;
+	constant(left ? node->right : node->left, score.threshold);
+	// higher scores are closer to satisfying the comparison
+	bool greater = op == GT_R || op == GTE_R;
+	score.sign = greater == left ? 1 : -1;
+	return true;
+}
+
+// checks formula over the steps row(0), row(1), ... of the variables names
+// until the checker decides it; sets length to the steps checked and best to
+// their best score, +infinity if they satisfy formula
+template <class Row>
+static valType check(Node *formula, const Splitting::Score &score, const vector<string> &names, Row row,
+					 int &length, double &best)
+{
+	Checker *c = new Checker(formula);
+	vector<pair<string, double> > state(names.size());
+	valType t = DONT_KNOW;
+	best = -numeric_limits<double>::infinity();
+	for (length = 0; t == DONT_KNOW; length++)
+	{
+		const vector<double> &values = row(length);
+		for (int i = 0; i < names.size(); i++)
+			state[i] = make_pair(names[i], values[i]);
+		{
+			ProfileScope scope(Profiler::CHECK);
+			t = c->advance(state, length);
+		}
+		best = max(best, score.sign * (values[score.variable] - score.threshold));
+	}
+	delete c;
+	if (t == SAT)
+		best = numeric_limits<double>::infinity();
+	return t;
+}
+
+double Splitting::best(Sampler &S, Node *formula, const Score &score)
+{
+	int length;
+	double best;
+	check(formula, score, S.model->cpd_order, [&](int r) -> const vector<double> & {
+		S.get_one_sample();
+		return S.value[S.NOW];
+	}, length, best);
+	Profiler::addTraces(1, S.sample_size);
+	return best;
+}
+
+Splitting::Splitting(const Sampler &model, Node *formula, Score score, int particles)
+	: model(model), formula(formula), score(score), particles(particles)
+{
+	this->model.setStorage(Sampler::STORE_NONE);
+	names = model.model->cpd_order;
+}
+
+unsigned long Splitting::simulate(Particle &p, uint64_t trace)
+{
+	Sampler &S = model;
+	if (p.rows.empty())
+	{
+		S.reset(trace);
+		S.resetBeta();
+	}
+	else
+		S.restart(&p.rows.back()[0], p.rows.size() - 1, trace);
+
+	// the checker goes over the steps kept, then over the new ones
+	unsigned long steps = 0;
+	int length;
+	check(formula, score, names, [&](int r) -> const vector<double> & {
+		if (r == p.rows.size())
+		{
+			S.get_one_sample();
+			p.rows.push_back(S.value[S.NOW]);
+			steps++;
+		}
+		return p.rows[r];
+	}, length, p.best);
+	// decided: the rest of the steps kept, if any, are not the trace's
+	p.rows.resize(length);
+	Profiler::addTraces(1, steps);
+	return steps;
+}
+
+Splitting::Run Splitting::run(uint64_t first)
+{
+	Run result;
+	result.iterations = 0;
+	result.steps = 0;
+	vector<Particle> p(particles);
+	uint64_t next = first;
+	for (int i = 0; i < particles; i++)
+		result.steps += simulate(p[i], next++);
+
+	// the parents are drawn from the sequential stream of trace first, whose
+	// steps count down from 2^32 - 1, apart from the keyed draws of its steps
+	RandomStream rng(first);
+	double estimate = 1;
+	while (true)
+	{
+		double level = numeric_limits<double>::infinity();
+		for (int i = 0; i < particles; i++)
+			level = min(level, p[i].best);
+		// all of them satisfy the property
+		if (level == numeric_limits<double>::infinity())
+			break;
+		vector<int> killed, kept;
+		for (int i = 0; i < particles; i++)
+			(p[i].best <= level ? killed : kept).push_back(i);
+		estimate *= double(kept.size()) / particles;
+		// all of them are killed, or the estimate is below what a double holds
+		if (kept.empty() || estimate < 1e-300)
+		{
+			estimate = 0;
+			break;
+		}
+		for (int k = 0; k < killed.size(); k++)
+		{
+			const Particle &parent = p[kept[min(int(rng.uniform() * kept.size()), int(kept.size()) - 1)]];
+			// its steps up to the first one above the level, all of them when
+			// it only gets there by satisfying the property
+			int r = 0;
+			while (r + 1 < parent.rows.size() && scoreOf(parent.rows[r]) <= level)
+				r++;
+			Particle &clone = p[killed[k]];
+			clone.rows.assign(parent.rows.begin(), parent.rows.begin() + r + 1);
+			result.steps += simulate(clone, next++);
+		}
+		result.iterations++;
+	}
+	result.estimate = estimate;
+	return result;
+}
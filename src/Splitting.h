@@ -0,0 +1,69 @@
+#pragma once
+#include "interface.hpp"
+
+/**
+ * Adaptive multilevel splitting (Cerou and Guyader, 2007) for the
+ * probability that a trace of a DBN satisfies a BLTL property, when it is
+ * too small for the traces of the sequential tests to ever satisfy it.
+ *
+ * A run draws N traces, the particles, and scores every step of them. At
+ * every iteration the particles whose best score is the lowest one, Z, are
+ * killed, and each of them is replaced by a clone of a survivor drawn at
+ * random: the steps of the survivor up to the first one scored above Z,
+ * continued with noise of its own. The estimate is the product of the
+ * fractions of the particles kept, once all of them satisfy the property or
+ * all are killed.
+ *
+ * A particle that satisfies the property, as decided by the checker on its
+ * whole trace, scores +infinity at its last step, so that the estimate is
+ * unbiased whatever the score (Brehier, Lelievre and Rousset, 2016); the
+ * score only decides its variance.
+ */
+class Splitting : private Tools
+{
+public:
+	// the score of a step: sign * (value of variable - threshold)
+	struct Score
+	{
+		int variable;
+		double sign, threshold;
+	};
+	// the score of the single comparison of a variable with a constant in
+	// formula, false with why when it has none or several
+	static bool derive(Node *formula, const Model &model, Score &score, string &why);
+
+	// draws the trace S was reset to until the checker decides formula,
+	// returns its best score, +infinity if it satisfies formula
+	static double best(Sampler &S, Node *formula, const Score &score);
+
+	Splitting(const Sampler &model, Node *formula, Score score, int particles);
+
+	struct Run
+	{
+		double estimate;
+		int iterations;     // the levels
+		unsigned long steps; // simulated
+	};
+	// a run, whose particles draw their noise as the traces first, first + 1, ...
+	Run run(uint64_t first);
+
+private:
+	Sampler model;
+	Node *formula;
+	Score score;
+	int particles;
+	vector<string> names; // of the variables, for the checker
+
+	struct Particle
+	{
+		vector<vector<double> > rows; // its steps
+		double best;                  // its best score, +infinity if it satisfies the property
+	};
+	// simulates p as trace from its last row on (from the start when it has
+	// none), until the checker decides it; returns the steps simulated
+	unsigned long simulate(Particle &p, uint64_t trace);
+	double scoreOf(const vector<double> &row) const
+	{
+		return score.sign * (row[score.variable] - score.threshold);
+	}
+};
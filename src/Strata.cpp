@@ -0,0 +1,108 @@
+#include "Strata.h"
+
+Strata::Strata(const Model &model, int groups) : proportional(true)
+{
+	edges.resize(model.variable_num);
+	for (int r = 0; r < model.betas.size(); r++)
+	{
+		for (int v = model.betas[r].first; v < model.betas[r].first + model.betas[r].second; v++)
+		{
+			betas.push_back(v);
+			// the groups end at the ends of bins, the first ones past every
+			// multiple of 1 / groups of the mass
+			const vector<double> &p = model.net_DBN.cpd_list[v].beta_p;
+			double sum = 0;
+			for (int i = 0; i < p.size(); i++)
+				sum += p[i];
+			double mass = 0;
+			for (int i = 0; i < p.size() - 1; i++)
+			{
+				mass += p[i];
+				double end = mass / sum;
+				int j = edges[v].size();
+				if (end >= double(j + 1) / groups && end < 1 - 1e-12 && (j == 0 || end > edges[v][j - 1]))
+					edges[v].push_back(end);
+			}
+			edges[v].push_back(1);
+		}
+	}
+}
+
+int Strata::group(int v, double u) const
+{
+	return min(int(upper_bound(edges[v].begin(), edges[v].end(), u) - edges[v].begin()), groups(v) - 1);
+}
+
+int Strata::groups(int v) const
+{
+	return edges[v].size();
+}
+
+void Strata::stratify(const vector<int> &variables)
+{
+	stratified = variables;
+	weights.assign(1, 1.0);
+	for (int k = 0; k < stratified.size(); k++)
+	{
+		const vector<double> &e = edges[stratified[k]];
+		if (weights.size() * e.size() > MAX)
+			Tools::fail("Error: more than " + to_string(MAX) + " strata, stratify fewer variables or fewer -stratabins.");
+		// the groups of variable k vary slowest
+		vector<double> w;
+		for (int j = 0; j < e.size(); j++)
+		{
+			for (int h = 0; h < weights.size(); h++)
+				w.push_back(weights[h] * (e[j] - (j == 0 ? 0 : e[j - 1])));
+		}
+		weights = w;
+	}
+	allocate(weights);
+}
+
+int Strata::of(const vector<int> &group) const
+{
+	int h = 0;
+	for (int k = stratified.size() - 1; k >= 0; k--)
+		h = h * groups(stratified[k]) + group[stratified[k]];
+	return h;
+}
+
+void Strata::allocate(const vector<double> &share)
+{
+	double sum = 0;
+	for (int h = 0; h < share.size(); h++)
+		sum += share[h];
+	cumulative.resize(share.size());
+	double c = 0;
+	for (int h = 0; h < share.size(); h++)
+		cumulative[h] = (c += share[h]) / sum;
+	cumulative.back() = 1;
+	proportional = share == weights;
+}
+
+int Strata::of(uint64_t trace) const
+{
+	// the radical inverse of trace in base 2
+	uint64_t x = trace;
+	x = ((x >> 1) & 0x5555555555555555ULL) | ((x & 0x5555555555555555ULL) << 1);
+	x = ((x >> 2) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+	x = ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+	x = ((x >> 8) & 0x00FF00FF00FF00FFULL) | ((x & 0x00FF00FF00FF00FFULL) << 8);
+	x = ((x >> 16) & 0x0000FFFF0000FFFFULL) | ((x & 0x0000FFFF0000FFFFULL) << 16);
+	x = (x >> 32) | (x << 32);
+	double r = (x >> 11) * (1.0 / 9007199254740992.0);
+	return min(int(upper_bound(cumulative.begin(), cumulative.end(), r) - cumulative.begin()), count() - 1);
+}
+
+void Strata::condition(uint64_t trace, double *u) const
+{
+	int h = of(trace);
+	for (int k = 0; k < stratified.size(); k++)
+	{
+		int v = stratified[k];
+		int j = h % groups(v);
+		h /= groups(v);
+		double low = j == 0 ? 0 : edges[v][j - 1];
+		u[v] = low + u[v] * (edges[v][j] - low);
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "Model.h"
+
+/**
+ * Strata of the traces of a DBN by the histogram bins of its beta variables.
+ * The bins of every beta variable are merged into groups of about the same
+ * prior mass, and a stratum is one combination of the groups of the
+ * stratified variables; its weight is the product of their masses.
+ *
+ * The stratum of a trace only depends on its index: trace t takes the
+ * stratum whose interval of the cumulative allocation holds the radical
+ * inverse of t, so that every prefix of the traces follows the allocation
+ * within a few traces, whatever the order they are drawn in. A trace of
+ * stratum h draws its beta variables from the prior conditioned on h: the
+ * uniform draw that picks the bin of a stratified variable is mapped into the
+ * interval of its group.
+ */
+class Strata
+{
+public:
+	static const int MAX = 4096; // strata
+
+	// groups groups per beta variable of model, no variable stratified yet
+	Strata(const Model &model, int groups);
+
+	vector<int> betas; // the beta variables
+	// the group of beta variable v whose uniform draw 0 is u
+	int group(int v, double u) const;
+	int groups(int v) const;
+
+	// strata by the groups of variables, their allocation proportional to
+	// their weights; fails beyond MAX strata
+	void stratify(const vector<int> &variables);
+	const vector<int> &variables() const { return stratified; }
+	int count() const { return weights.size(); }
+	// the stratum of the groups group[v] of the beta variables v
+	int of(const vector<int> &group) const;
+	// the prior mass of every stratum
+	vector<double> weights;
+	// the share of the traces of every stratum, proportional by default
+	void allocate(const vector<double> &share);
+	// whether the shares are the weights: the traces are then drawn from
+	// the prior, and their counts are plain counts
+	bool proportional;
+
+	// the stratum of trace
+	int of(uint64_t trace) const;
+	// maps the uniform draws 0 u[v] of the stratified variables of trace into
+	// the groups of its stratum
+	void condition(uint64_t trace, double *u) const;
+
+private:
+	vector<vector<double> > edges; // per variable, the draws 0 that end its groups
+	vector<int> stratified;
+	vector<double> cumulative; // of the allocation, per stratum
+};
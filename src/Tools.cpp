@@ -1,8 +1,20 @@
 #include "Tools.h"
+#include "RandomStream.h"
+#include <atomic>
+#include <stdexcept>
+
+bool Tools::throwErrors = false;
 
 Tools::Tools()
 {
 }
+void Tools::fail(string message)
+{
+	if (throwErrors)
+		throw runtime_error(message);
+	cerr << message << endl;
+	exit(EXIT_FAILURE);
+}
 void Tools::creatFolder(string pDir)
 {
 	int i = 0;
@@ -124,45 +136,34 @@ double Tools::Execute(double b, char op, double a)
 	return result;
 }
 
+// every thread draws from its own stream, far away from the traces of the
+// samplers, which use their own keyed streams
+static atomic<uint64_t> streamCount(0);
+static RandomStream &threadStream()
+{
+	thread_local RandomStream stream(~(uint64_t)0 - streamCount++);
+	return stream;
+}
 int Tools::randomint(int min, int max)
 {
-	srand((unsigned)time(NULL)); 
-	return rand() % (max - min) + min;
+	return int(threadStream().uniform() * (max - min)) + min;
 }
 
 double Tools::randomfloat(double min, double max)
 {
-	std::uniform_real_distribution<double> dist(0, 1.0);
-	std::mt19937 rng;
-	rng.seed(std::random_device{}());
-	return (max - min) * dist(rng) + min;
+	return (max - min) * threadStream().uniform() + min;
 }
 double Tools::gaussrand()
 {
-	static double V1, V2, S;
-	static int phase = 0;
-	double X;
-	if (phase == 0)
-	{
-		do
-		{
-			double U1 = randomfloat(0, 1);
-			double U2 = randomfloat(0, 1);
-			V1 = 2 * U1 - 1;
-			V2 = 2 * U2 - 1;
-			S = V1 * V1 + V2 * V2;
-		} while (S >= 1 || S == 0);
-		X = V1 * sqrt(-2 * log(S) / S);
-	}
-	else
-		X = V2 * sqrt(-2 * log(S) / S);
-	phase = 1 - phase;
-	return X;
+	return threadStream().normal();
 }
 int Tools::RandomChosse(vector<double> possiblelist)
+{
+	return RandomChosse(possiblelist, randomfloat(0.0, 1.0));
+}
+int Tools::RandomChosse(vector<double> possiblelist, double randomfloatnum)
 {
 	double sumpossible = 0.0;
-	double randomfloatnum = randomfloat(0.0, 1.0);
 	//cout<<randomfloatnum<<endl;
 	for (int i = 0; i < possiblelist.size(); i++)
 	{
@@ -179,34 +180,18 @@ int Tools::RandomChosse(vector<double> possiblelist)
 }
 vector<string> Tools::merge_v(vector<string> v1, vector<string> v2)
 {
+	set<string> seen(v2.begin(), v2.end());
 	for (int i = 0; i < v1.size(); i++)
 	{
-		int flag = 0;
-		for (int j = 0; j < v2.size(); j++)
-		{
-			if (v1[i] == v2[j])
-			{
-				flag = 1;
-				break;
-			}
-		}
-		if (flag == 0)
+		if (seen.insert(v1[i]).second)
 			v2.push_back(v1[i]);
 	}
 	return v2;
 }
-void Tools::insert_v(vector<string> &v1, string t)
+//seen mirrors v1 so the membership test stays logarithmic on large models
+void Tools::insert_v(vector<string> &v1, set<string> &seen, string t)
 {
-	int flag = 0;
-	for (int j = 0; j < v1.size(); j++)
-	{
-		if (v1[j] == t)
-		{
-			flag = 1;
-			break;
-		}
-	}
-	if (flag == 0)
+	if (seen.insert(t).second)
 		v1.push_back(t);
 }
 map<string, string> Tools::getArgvMap(int argc, char **argv)
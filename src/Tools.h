@@ -9,6 +9,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <map>
+#include <set>
 #include <stdarg.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -26,9 +27,10 @@ class Tools
 	bool Compare(char, char);
 	double Execute(double, char, double);
 	int RandomChosse(vector<double>);
+	int RandomChosse(vector<double>, double);
 	int randomint(int min, int max);
 	vector<string> merge_v(vector<string> v1, vector<string> v2);
-	void insert_v(vector<string> &v1, string t);
+	void insert_v(vector<string> &v1, set<string> &seen, string t);
 	double gaussrand();
 	void creatFolder(string);
 	double randomfloat(double min, double max);
@@ -40,6 +42,12 @@ class Tools
 	bool isInt(string);
 	bool isDouble(string);
 	bool findString(string , string );
+
+	// ends the run on an error in its input: prints message and exits, or,
+	// while throwErrors is set (setting up the jobs of a batch), throws it as
+	// a runtime_error so that the other jobs go on
+	static bool throwErrors;
+	static void fail(string message);
 	char ops[8] = {'+', '-', '*','/','^', '#', '(', ')'};
 	int cmp[5][5] = {
 		{2, 2, 1, 1, 1},
@@ -56,10 +64,31 @@ class Tools
         "where:\n"
         	"<testfile> is a text file containing a sequence of test specifications, give the path to it;\n"
     		"<modelfile> is the file name and path of the WM model under analysis;\n"
-    		"<propertyfile> is the file name and path of properties to be checked;\n"
+    		"<propertyfile> is the file name and path of properties to be checked, several files can be separated by ',' and several formulas in a file by ';';\n"
     		"<interventionfile> is the file name and path of Intervention to be implemented. This parameter is optional;\n"
     		"<initialfile> is the file name and path of the initial value of variables in simulation. This parameter is optional;\n"
-
+		"Optional parameters:\n"
+			" -engine <inprocess|check>: \"inprocess\" (default) loads the model and property once per run, \"check\" spawns ./Check for every sample;\n"
+			" -async true: threads never wait for each other, tests are evaluated on the samples in the order they were started;\n"
+			" -batchsize <K>: without -async, every thread checks K traces per round (default 1), the tests still stop at the trace that decides them;\n"
+			" -lanes <W>: every thread draws W traces of a DBN side by side, with vector instructions, in its rounds or worker batches;\n"
+			" -savetraces false: the traces are checked as they are drawn but not kept nor written (inprocess engine);\n"
+			" -native true|build: the steps of a DBN run as native code, compiled once into the cache of -nativedir <dir> (../native); build only compiles it;\n"
+			" -seed <n>: seed of the random numbers, a run with -async true is reproducible from it whatever the number of threads;\n"
+			" -sampling qmc: the traces are the points of -randomizations <R> (16) scrambled Sobol sequences, the estimates get the interval of the R;\n"
+			" -antithetic true: the traces come in antithetic pairs, the estimation tests stop on the interval of the pairs;\n"
+			" -control \"<variable>[<step>]\": the value of variable at step, of closed-form mean, is a control variate of the estimates;\n"
+			" -stratify \"<beta variable>,...\"|auto: strata by -stratabins <g> (4) groups of their bins, -allocation proportional|neyman;\n"
+			" -splitting <particles>: estimates the probability of rare properties by -splitruns <R> (10) runs of adaptive multilevel splitting, -score \"[-]<variable>\";\n"
+			" -proposal <file>|ce: importance sampling from the shifts and powers of file, or tuned by -ceiterations <k> (10) rounds of cross-entropy;\n"
+			" -checkpoint <file>: saves the state of the run to file every -checkpointperiod <seconds> (default 60) and at the end;\n"
+			" -resume <file>: continues the run saved in the checkpoint file;\n"
+			" -coordinator <address>: distributes the traces over ./SMC_wm -worker <address> processes, by batches of -netbatch <n> (default 64), address is unix:<path>, <host>:<port> or <port>;\n"
+			" -progress <seconds>: prints the throughput, the running estimates and the time per phase every that many seconds;\n"
+			" -progressjson <file>: writes the same reports to file as JSON lines (every 10 seconds by default);\n"
+			" -profile true: times load, parse, simulate, check, save and test per thread and prints a summary table at exit;\n"
+			" -batch <manifest>: runs the jobs of the manifest, one run's arguments per line, on one pool of threads and writes one JSON record per job to -batchresults <file> (default <manifest>.results);\n"
+		"\n"
 		"Available test specifications: \n\n"
 		"Hypothesis test:\n"
 		" Lai's test: Lai <theta> <cost per sample>\n"
@@ -83,6 +112,8 @@ class Tools
     		"<initialfile> is the file name and path of the initial value of variables in simulation. This parameter is optional;\n"
 			"<variableInfo> is a string. Contains the name of the variable being queried and the number of steps. The number of steps should be enclosed in \'[\' and \']\' , placed after the variable name and must be greater than or equal to 1, for example: \"market[100]\";\n"
 			"<intervalNum> is an integer representing the number of intervals used to display the distribution;\n"
-			"<outputfile> is the file name and path of the result. This parameter is optional. The default file is \"SMC4WM/Distribution.txt\"" 
+			"<outputfile> is the file name and path of the result. This parameter is optional. The default file is \"SMC4WM/Distribution.txt\";\n"
+			"-exact true computes the distribution at a forward step of a linear-Gaussian model instead of sampling it, with its mean, standard deviation and quantiles; with beta variables it is a mixture over draws of them, reported with the half-widths of its error;\n"
+			"-exactdraws <M> is the number of draws of the beta variables the mixture of -exact true takes (1000 by default)." 
 		;
 };
@@ -5,6 +5,7 @@
  */
 
 #include "checker.hpp"
+#include "Profiler.h"
 
 Checker::Checker() {
   /* val_init_tree is the value propagated to the root of the very first tree
@@ -16,6 +17,21 @@ Checker::Checker() {
   prev_vect.clear();
   prev_vect_map.clear();
   ts_old = ts_new = 0.0;
+  formula = parse_tree;
+}
+
+/**
+ * checker of the property whose parse tree is `root', which is only read so
+ * that several checkers can share it
+ */
+Checker::Checker(Node *root) {
+  val_init_tree = DONT_KNOW;
+  curr_list.clear();
+  aux_list.clear();
+  prev_vect.clear();
+  prev_vect_map.clear();
+  ts_old = ts_new = 0.0;
+  formula = root;
 }
 
 Checker::~Checker() {
@@ -409,6 +425,7 @@ void Checker::build_from(LogicalRelationalNode *prev_tree, double duration) {
  * wrapper function for build_from to build trees from prev_vect
  */
 void Checker::build_tree_list(double duration) {
+  ProfileScope scope(Profiler::CHECK_BUILD);
   vector<pair<LogicalRelationalNode *, bool> >::iterator it;
   if (prev_vect.empty() == true) {
     /* first iteration */
@@ -416,7 +433,7 @@ void Checker::build_tree_list(double duration) {
       cout << "error : initial timestamp is greater than zero!" << endl;
       exit(EXIT_FAILURE);
     }
-    curr_list.push_back(make_pair((LogicalRelationalNode *)nodep_copy(parse_tree, ts_new),false));
+    curr_list.push_back(make_pair((LogicalRelationalNode *)nodep_copy(formula, ts_new),false));
   } else {
     for (it = prev_vect.begin(); it != prev_vect.end(); it++) {
       if ((*it).second == false) {
@@ -1644,6 +1661,7 @@ void Checker::propagate_value(LogicalRelationalNode *n, double bound, nodeType f
  */
 void Checker::propagate(void) { /* each node in init_propagateList already has values.
                                  * so, just propagate and delete itself */
+  ProfileScope scope(Profiler::CHECK_PROPAGATE);
   list<LogicalRelationalNode *>::iterator it;
   for (it = init_propagateList.begin(); it != init_propagateList.end(); it++) {
     /* note that init_propagateList only contains evaluated RelationalNodes or NOOP LogicalNodes.
@@ -1658,6 +1676,7 @@ void Checker::propagate(void) { /* each node in init_propagateList already has v
  * to propagate those values
  */
 valType Checker::evaluate(vector<pair<string, double> > state) {
+  ProfileScope scope(Profiler::CHECK_EVALUATE);
   list<pair<LogicalRelationalNode *, bool> >::iterator it;
   list<pair<pair<LogicalRelationalNode *, int>, bool> >::iterator it1;
   for (it = curr_list.begin(); it != curr_list.end(); it++) {
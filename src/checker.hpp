@@ -11,6 +11,7 @@ private:
   map<LogicalRelationalNode *, int> prev_vect_map;
   valType val_init_tree;
   double ts_new, ts_old;
+  Node *formula; /* parse tree of the property being checked */
 
   void patch (LogicalRelationalNode *, LogicalRelationalNode *, double);
   Node *node_copy(Node *, double);
@@ -34,6 +35,7 @@ private:
   valType evaluate(vector<pair<string, double> >);
 public:
   Checker();
+  Checker(Node *);
   ~Checker();
   valType advance(vector<pair<string, double> >, double);
 };
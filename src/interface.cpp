@@ -4,9 +4,12 @@
  * checker
  */
 #include "interface.hpp"
+#include "Profiler.h"
+#include "Tools.h"
 #include <stdio.h>
 #include <vector>
 #include <iostream>
+#include <sstream>
 #include <string>
 using namespace std;
 #ifdef YYPARSE_PARAM
@@ -23,13 +26,19 @@ extern int yyparse();
 #endif
 #endif /* ! YYPARSE_PARAM */
 extern FILE *yyin;
+typedef struct yy_buffer_state *YY_BUFFER_STATE;
+extern YY_BUFFER_STATE yy_scan_string(const char *);
+extern void yy_delete_buffer(YY_BUFFER_STATE);
 interface::interface()
 {
     trace_num = 0;
+    c = NULL;
+    formula = NULL;
 }
 interface::interface(string File)
 {
     trace_num = 0;
+    c = NULL;
     propFile = File;
     yyin = fopen(propFile.c_str(), "r");
     if (!yyin)
@@ -37,8 +46,55 @@ interface::interface(string File)
         fprintf(stderr, "ERROR: Property file does not exist\n");
         exit(EXIT_FAILURE);
     }
-    yyparse();
+    {
+        ProfileScope scope(Profiler::PARSE);
+        yyparse();
+    }
     fclose(yyin);
+    formula = parse_tree;
+}
+/**
+ * reads the properties of a comma separated list of files, every file holds
+ * one formula or several formulas separated by ';'
+ *
+ * returns one interface per formula, in the order they were read
+ */
+vector<interface> interface::readProperties(string files)
+{
+    vector<interface> props;
+    stringstream fileList(files);
+    string file;
+    while (getline(fileList, file, ','))
+    {
+        ifstream input(file);
+        if (!input.is_open())
+        {
+            Tools::fail("ERROR: Property file does not exist: " + file);
+        }
+        stringstream content;
+        content << input.rdbuf();
+        string text;
+        while (getline(content, text, ';'))
+        {
+            if (text.find_first_not_of(" \t\r\n") == string::npos)
+                continue;
+            interface I;
+            I.propFile = file;
+            I.formulaText = text.substr(text.find_first_not_of(" \t\r\n"));
+            I.formulaText.erase(I.formulaText.find_last_not_of(" \t\r\n") + 1);
+            ProfileScope scope(Profiler::PARSE);
+            YY_BUFFER_STATE buffer = yy_scan_string(I.formulaText.c_str());
+            yyparse();
+            yy_delete_buffer(buffer);
+            I.formula = parse_tree;
+            props.push_back(I);
+        }
+    }
+    if (props.size() == 0)
+    {
+        Tools::fail("ERROR: No property in " + files);
+    }
+    return props;
 }
 /**
  * assuming the external software is a C code
@@ -64,9 +120,13 @@ void interface::read_property(char *file)
         fprintf(stderr, "ERROR: Property file does not exist\n");
         exit(EXIT_FAILURE);
     }
-    yyparse();
+    {
+        ProfileScope scope(Profiler::PARSE);
+        yyparse();
+    }
     fclose(yyin);
     c = NULL;
+    formula = parse_tree;
 }
 
 /**
@@ -96,7 +156,7 @@ void interface::init_signals(vector<string> list)
 #endif
     /* create a new checker */
     delete c;
-    c = new Checker();
+    c = new Checker(formula);
 }
 /**
  * advances model checking the trace by one step
@@ -137,22 +197,36 @@ valType interface::advance(vector<double> new_state)
     state.clear();
     return result;
 }
-bool interface::check_trace(Sampler sample1, char *prop_file1, string modelfile)
+bool interface::check_trace(Sampler &sample1, char *prop_file1, string modelfile)
 {
-    //ofstream file1(tracefile);
-    vector<string> state_vars;
-    valType t;
-    double ts;
-    vector<pair<string, double> > state;
     yyin = fopen(prop_file1, "r");
     if (!yyin)
     {
         fprintf(stderr, "ERROR: Property file does not exist\n");
         exit(EXIT_FAILURE);
     }
-    yyparse();
+    {
+        ProfileScope scope(Profiler::PARSE);
+        yyparse();
+    }
     fclose(yyin);
-    c = new Checker();
+    formula = parse_tree;
+    return check_trace(sample1);
+}
+/**
+ * checks one trace of sample1 against the property already parsed in formula
+ *
+ * the trace is generated step by step until the checker decides it, and is
+ * saved under the SAT or UNSAT folder of tracefile
+ */
+bool interface::check_trace(Sampler &sample1)
+{
+    //ofstream file1(tracefile);
+    vector<string> state_vars;
+    valType t;
+    double ts;
+    vector<pair<string, double> > state;
+    c = new Checker(formula);
 
     //cout<<"check"<<endl;
     ts = 0;
@@ -171,9 +245,9 @@ bool interface::check_trace(Sampler sample1, char *prop_file1, string modelfile)
             //file1<<"time";
             for (int i = 0; i < sample1.variable_num; i++)
             { //
-                state_vars.push_back(string(sample1.cpd_order[i]));
+                state_vars.push_back(string(sample1.model->cpd_order[i]));
                 //file1<<" "<<sample1.cpd_order[i];
-                //cout<<string(sample1.cpd_order[i])<<endl;
+                //cout<<string(sample1.model->cpd_order[i])<<endl;
             }
             //file1<<endl;
         }
@@ -190,6 +264,8 @@ bool interface::check_trace(Sampler sample1, char *prop_file1, string modelfile)
         {
             tracefile += "/SAT/trace_" + to_string(trace_num);
             sample1.saveSampleResult(tracefile);
+            delete c;
+            c = NULL;
             //file1<<"#"<<modelfile<<endl;
             //file1<<"#"<<prop_file1<<endl;
             //file1<<"1"<<endl;
@@ -200,6 +276,8 @@ bool interface::check_trace(Sampler sample1, char *prop_file1, string modelfile)
         {
             tracefile += "/UNSAT/trace_" + to_string(trace_num);
             sample1.saveSampleResult(tracefile);
+            delete c;
+            c = NULL;
             //file1<<"#"<<modelfile<<endl;
             //file1<<"#"<<prop_file1<<endl;
             //file1<<"0"<<endl;
@@ -218,8 +296,10 @@ int interface::checkmodel(string modelfile, char *propfile, string folder_name,
     tracefile += folder_name;
     trace_num = numTrace;
     Sampler sample1(modelfile, interfile);
+    sample1.setTrace(numTrace);
+    sample1.resetBeta();
     sample1.getInital(initfile);
-    sample1.net_BN.get_cpd_info();
+    sample1.model->net_BN.get_cpd_info();
 
     //cout<<modelfile<<endl;
     //gm.bayesnet.get_cpd_info();
@@ -240,6 +320,186 @@ int interface::checkmodel(string modelfile, char *propfile, string folder_name,
         return 0;
     }
 }
+/**
+ * in-process counterpart of the Check binary: checks one trace of an already
+ * loaded model against the already parsed property
+ *
+ * returns 1 if the trace satisfies the property, 0 otherwise
+ */
+int interface::checkmodel(Sampler &sample1, string folder_name, int numTrace)
+{
+    tracefile = folder_name;
+    trace_num = numTrace;
+    int result = check_trace(sample1);
+    if (numTrace == 0)
+    {
+        outputStruct(folder_name + "/STRUCTINFO/", sample1);
+        getGraph(sample1);
+    }
+    return result;
+}
+/**
+ * checks one trace of sample1 against all the properties props[k] such that
+ * active[k] holds, the trace is generated only once and as long as one of
+ * them is not decided yet
+ *
+ * the trace is saved under the SAT or UNSAT folder of folder_name[k] up to
+ * the step property k is decided
+ *
+ * returns for every property 1 if the trace satisfies it, 0 if it does not,
+ * -1 if it was not checked
+ */
+vector<int> interface::checkmodel(Sampler &sample1, vector<interface> &props, vector<string> folder_name, unsigned long numTrace, vector<bool> active)
+{
+    vector<int> result(props.size(), -1);
+    vector<int> length(props.size(), 0); // step at which the property is decided
+    vector<string> state_vars;
+    vector<pair<string, double> > state;
+    int undecided = 0;
+    for (int k = 0; k < props.size(); k++)
+    {
+        if (!active[k])
+            continue;
+        props[k].trace_num = numTrace;
+        props[k].c = new Checker(props[k].formula);
+        undecided++;
+    }
+    // STRUCTINFO and the graph are built from the initial state, as Check does
+    if (numTrace == 0)
+    {
+        for (int k = 0; k < props.size(); k++)
+        {
+            if (active[k])
+                props[k].outputStruct(folder_name[k] + "/STRUCTINFO/", sample1);
+        }
+        props[0].getGraph(sample1);
+    }
+    double ts = 0;
+    while (undecided > 0)
+    {
+        sample1.get_one_sample();
+        ProfileScope scope(Profiler::CHECK);
+        if (sample1.sample_size == 1)
+        {
+            for (int i = 0; i < sample1.variable_num; i++)
+                state_vars.push_back(string(sample1.model->cpd_order[i]));
+        }
+        for (int j = 0; j < state_vars.size(); j++)
+            state.push_back(make_pair(state_vars.at(j), sample1.value[sample1.NOW][j]));
+        for (int k = 0; k < props.size(); k++)
+        {
+            if (props[k].c == NULL)
+                continue;
+            valType t = props[k].c->advance(state, ts);
+            if (t != SAT && t != UNSAT)
+                continue;
+            result[k] = (t == SAT);
+            length[k] = sample1.sample_size;
+            delete props[k].c;
+            props[k].c = NULL;
+            undecided--;
+        }
+        state.clear();
+        ts += 1;
+    }
+    Profiler::addTraces(1, sample1.sample_size);
+    for (int k = 0; k < props.size(); k++)
+    {
+        if (!active[k])
+            continue;
+        props[k].tracefile = folder_name[k] + (result[k] == 1 ? "/SAT/trace_" : "/UNSAT/trace_") + to_string(numTrace);
+        if (sample1.keeps(length[k]))
+            sample1.saveSampleResult(props[k].tracefile, length[k]);
+    }
+    return result;
+}
+/**
+ * checkmodel() for the lanes of batch: every lane is a trace of its own,
+ * checked against the properties props[k] such that active[k] holds. The
+ * lanes step together as long as one of them is not decided, the decided
+ * lanes at the end of the batch are not simulated any more.
+ *
+ * returns the results of every lane, as checkmodel() returns them for one
+ * trace
+ */
+vector<vector<int> > interface::checkmodel(BatchSampler &batch, vector<interface> &props, vector<string> folder_name, vector<bool> active)
+{
+    int lanes = batch.lanes;
+    vector<vector<int> > result(lanes, vector<int>(props.size(), -1));
+    vector<vector<int> > length(lanes, vector<int>(props.size(), 0)); // step at which the property is decided
+    vector<vector<Checker *> > c(lanes, vector<Checker *>(props.size(), NULL));
+    vector<int> undecided(lanes, 0);
+    vector<int> steps(lanes, 0); // step at which the lane is decided
+    for (int k = 0; k < props.size(); k++)
+    {
+        if (!active[k])
+            continue;
+        props[k].trace_num = batch.first;
+        for (int l = 0; l < lanes; l++)
+        {
+            c[l][k] = new Checker(props[k].formula);
+            undecided[l]++;
+        }
+    }
+    if (batch.first == 0)
+    {
+        Sampler sample1 = batch.laneSampler(0);
+        for (int k = 0; k < props.size(); k++)
+        {
+            if (active[k])
+                props[k].outputStruct(folder_name[k] + "/STRUCTINFO/", sample1);
+        }
+        props[0].getGraph(sample1);
+    }
+    vector<pair<string, double> > state;
+    double ts = 0;
+    while (true)
+    {
+        while (batch.count > 0 && undecided[batch.count - 1] == 0)
+            batch.count--;
+        if (batch.count == 0)
+            break;
+        batch.get_one_sample();
+        ProfileScope scope(Profiler::CHECK);
+        for (int l = 0; l < batch.count; l++)
+        {
+            if (undecided[l] == 0)
+                continue;
+            for (int j = 0; j < batch.variable_num; j++)
+                state.push_back(make_pair(batch.model->cpd_order[j], batch.getValue(l, j)));
+            for (int k = 0; k < props.size(); k++)
+            {
+                if (c[l][k] == NULL)
+                    continue;
+                valType t = c[l][k]->advance(state, ts);
+                if (t != SAT && t != UNSAT)
+                    continue;
+                result[l][k] = (t == SAT);
+                length[l][k] = batch.sample_size;
+                delete c[l][k];
+                c[l][k] = NULL;
+                undecided[l]--;
+            }
+            if (undecided[l] == 0)
+                steps[l] = batch.sample_size;
+            state.clear();
+        }
+        ts += 1;
+    }
+    unsigned long total = 0;
+    for (int l = 0; l < lanes; l++)
+        total += steps[l];
+    Profiler::addTraces(lanes, total);
+    for (int l = 0; l < lanes; l++)
+    {
+        for (int k = 0; k < props.size(); k++)
+        {
+            if (active[k] && batch.keep)
+                batch.saveSampleResult(l, folder_name[k] + (result[l][k] == 1 ? "/SAT/trace_" : "/UNSAT/trace_") + to_string(batch.first + l), length[l][k]);
+        }
+    }
+    return result;
+}
 void interface::sample(int num, string modelfile, string file)
 {
     Sampler sample1(modelfile, "");
@@ -253,7 +513,7 @@ void interface::sample(int num, string modelfile, string file)
             file1 << "time";
             for (int j = 0; j < sample1.variable_num; j++)
             { //
-                file1 << " " << sample1.cpd_order[i];
+                file1 << " " << sample1.model->cpd_order[i];
             }
             file1 << endl;
         }
@@ -267,7 +527,7 @@ void interface::sample(int num, string modelfile, string file)
     }
     file1.close();
 }
-void interface::outputStruct(string folder, Sampler sample)
+void interface::outputStruct(string folder, Sampler &sample)
 {
     string filename = folder + "/" + "BN";
     if (trace_num != 0)
@@ -277,23 +537,24 @@ void interface::outputStruct(string folder, Sampler sample)
         creatFolder(folder);
         vector<string> NodesatT;
         vector<string> NodesatTplus1;
+        set<string> seenT, seenTplus1;
         vector<string> Nodes;
         vector<vector<string > > edge_LDBN;
         vector<vector<string > > edge_BN_c;
         vector<vector<string > > edge_BN;
 
-        for (int i = 0; i < sample.net_DBN.cpd_list.size(); i++)
+        for (int i = 0; i < sample.model->net_DBN.cpd_list.size(); i++)
         {
-            if (sample.net_DBN.cpd_list[i].intervention.size() > 0)
+            if (sample.model->net_DBN.cpd_list[i].intervention.size() > 0)
             {
                 vector<string> tempset;
-                string sonName = sample.net_DBN.cpd_list[i].cpd_name + "(t+1)";
-                insert_v(NodesatTplus1, sonName);
-                for (int j = 0; j < sample.net_DBN.cpd_list[i].intervention[0].Postfix.size(); j++)
+                string sonName = sample.model->net_DBN.cpd_list[i].cpd_name + "(t+1)";
+                insert_v(NodesatTplus1, seenTplus1, sonName);
+                for (int j = 0; j < sample.model->net_DBN.cpd_list[i].intervention[0].Postfix.size(); j++)
                 {
-                    if (sample.net_DBN.cpd_list[i].intervention[0].Postfix[j].type == 0)
+                    if (sample.model->net_DBN.cpd_list[i].intervention[0].Postfix[j].type == 0)
                     {
-                        string parName = sample.net_DBN.cpd_list[i].intervention[0].Postfix[j].name;
+                        string parName = sample.model->net_DBN.cpd_list[i].intervention[0].Postfix[j].name;
                         string::size_type nPos2 = 0;
                         nPos2 = parName.find("beta", nPos2);
                         if (nPos2 != string::npos)
@@ -303,12 +564,12 @@ void interface::outputStruct(string folder, Sampler sample)
                         if (nPos2 == string::npos)
                         {
                             parName += "(t)";
-                            insert_v(NodesatT, parName);
+                            insert_v(NodesatT, seenT, parName);
                         }
                         else
                         {
                             string_replace(parName, "_next", "(t+1)");
-                            insert_v(NodesatTplus1, parName);
+                            insert_v(NodesatTplus1, seenTplus1, parName);
                         }
                         tempset.push_back(parName);
                         vector<string> temp_edge;
@@ -412,13 +673,13 @@ void interface::outputStruct(string folder, Sampler sample)
         ofstream fout4(filename);
         fout4 << "Graph Nodes:" << endl;
         int sumNum = 0;
-        for(int i=0;i<sample.net_DBN.cpd_list.size();i++)
+        for(int i=0;i<sample.model->net_DBN.cpd_list.size();i++)
         {
-            if(sample.net_DBN.cpd_list[i].cpd_type!=2)
+            if(sample.model->net_DBN.cpd_list[i].cpd_type!=2)
             {
                 if(sumNum!=0)
                     fout4<<",";
-                fout4<<sample.net_DBN.cpd_list[i].cpd_name;
+                fout4<<sample.model->net_DBN.cpd_list[i].cpd_name;
                 sumNum++;
             }
         }
@@ -444,6 +705,9 @@ void interface::getGraph(Sampler sample)
         return;
     if (sample.sampler_type == 1)
     {
+        // the same trace again from its first step, the checker ran it on
+        sample.reset(trace_num);
+        sample.setStorage(Sampler::STORE_ALL);
         while (sample.sample_size < 1000)
         {
             sample.get_one_sample();
@@ -460,7 +724,7 @@ int interface::CheckBLTrace(vector<string> varName, vector<vector<int> > trace)
     traceLength = trace.size();
     valType t;
     double ts;
-    c = new Checker();
+    c = new Checker(formula);
     //cout<<"check"<<endl;
     ts = 0;
     
@@ -10,6 +10,7 @@
 #include<vector>
 
 #include"Sampler.h"
+#include"BatchSampler.h"
 
 #include <sys/types.h>
 #include <dirent.h>
@@ -21,22 +22,29 @@ public:
     interface(string);
     string tracefile;
     string propFile;
+    string formulaText; // the formula, as written in propFile
+    Node *formula;      // its parse tree, shared by all the copies of this interface
     vector<string> state_vars;
     vector<pair<string, double> > state;
     int length_explored;
-    int trace_num;
+    unsigned long trace_num;
     Checker *c;
     void read_property(char *);
     void init_signals(vector<string>);
     valType advance(vector<double>);
     int checkmodel(string modelfile, char *propfile, string folder_name, int numTrace, string interfile, string initfile);
-    bool check_trace(Sampler,char*,string);
+    int checkmodel(Sampler &sample1, string folder_name, int numTrace);
+    static vector<int> checkmodel(Sampler &sample1, vector<interface> &props, vector<string> folder_name, unsigned long numTrace, vector<bool> active);
+    static vector<vector<int> > checkmodel(BatchSampler &batch, vector<interface> &props, vector<string> folder_name, vector<bool> active);
+    static vector<interface> readProperties(string files);
+    bool check_trace(Sampler &,char*,string);
+    bool check_trace(Sampler &);
     void sample(int,string,string);
     int CheckBLTrace(vector<string> varName, vector<vector<int> > trace);
 private:
     int varNum;
     int traceLength;
-    void outputStruct(string, Sampler);
+    void outputStruct(string, Sampler &);
     void getGraph(Sampler);
 };
 #endif
@@ -0,0 +1,76 @@
+#!/bin/sh
+# Statistical checks of the variance reductions on the property of propmid,
+# whose probability P is the estimate of a plain run of NSAM 400000 traces
+# (seed 11), of 95% half-width H. With every reduction, seed 5 on one thread:
+# the interval of every estimation test covers P, widened by H, CHB stops
+# with a half-width of at most its delta, and the hypothesis tests, whose
+# thresholds are far from P, accept what they accept on plain traces.
+
+BIN=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+DIR=$(cd "$(dirname "$0")" && pwd)
+TESTCASE=$(dirname "$DIR")
+P=0.58319
+H=0.00153
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+cd "$WORK" || exit 1
+
+run()
+{
+    OMP_NUM_THREADS=1 "$BIN" -modelfile "$TESTCASE/cra_cag_praise_2019-02-03_01-14-16_histogram.dat" \
+        -initfile "$TESTCASE/intervention" -propfile "$DIR/propmid" -testfile "$DIR/checks" -seed 5 \
+        -savetraces false $1 2>&1
+}
+
+# the hypotheses accepted, one line per test
+verdicts()
+{
+    grep -E "^SPRT " | sed 's/, successes.*//' | sort
+}
+
+run "" > plain
+verdicts < plain > expected
+failed=0
+for OPTIONS in "-antithetic true" "-control Rainfall[5]" "-stratify beta_conflict_famine" \
+    "-stratify auto -allocation neyman" "-proposal ce" "-sampling qmc"
+do
+    run "$OPTIONS" > output
+    verdicts < output > got
+    if ! diff expected got > /dev/null
+    then
+        echo "$OPTIONS: the hypothesis tests disagree with the plain run:"
+        diff expected got
+        failed=1
+    fi
+    # the estimate and the half-width of the interval of every estimation
+    # test, of the randomizations with -sampling qmc
+    awk -v P=$P -v H=$H -v options="$OPTIONS" '
+        /^(CHB|BEST) / {
+            e = ""; h = ""
+            if (match($0, /RQMC estimate = [^ ]* \+- [^ ]*/)) {
+                split(substr($0, RSTART, RLENGTH), f, " ")
+                e = f[4]; h = f[6]
+            } else if (match($0, /half-width = [^ ]*/)) {
+                h = substr($0, RSTART + 13, RLENGTH - 13)
+                match($0, /estimate = [^,]*/)
+                e = substr($0, RSTART + 11, RLENGTH - 11)
+            }
+            if (h == "") {
+                print options ": no interval: " $0; bad = 1; next
+            }
+            if (e - P > h + H || P - e > h + H) {
+                print options ": the interval misses " P ": " $0; bad = 1
+            }
+            if ($1 == "CHB" && h + 0 > $2 + 0) {
+                print options ": the half-width exceeds delta: " $0; bad = 1
+            }
+            tests++
+        }
+        END {
+            if (tests != 2) {
+                print options ": " tests + 0 " estimation tests of 2"; bad = 1
+            }
+            exit bad
+        }' output || failed=1
+done
+exit $failed
@@ -0,0 +1,38 @@
+#!/bin/sh
+# Regression test of the variance reductions: every one of them on a property
+# of probability about 0.58 (famine on the histogram model) and on one of
+# probability 1 (Rainfall on newmodel.txt), where the tests must stop all the
+# same. The results of seed 3 on one thread are compared with the file
+# expected; run.sh <SMC_wm> update rewrites it.
+
+BIN=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+DIR=$(cd "$(dirname "$0")" && pwd)
+TESTCASE=$(dirname "$DIR")
+MODE=$2
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+cd "$WORK" || exit 1
+
+run()
+{
+    echo "== $1 $2 $3"
+    OMP_NUM_THREADS=1 "$BIN" -modelfile "$TESTCASE/$1" -initfile "$TESTCASE/intervention" -propfile "$DIR/$2" \
+        -testfile "$DIR/test" -seed 3 -savetraces false $3 2>&1 | grep -v -E "^(Elapsed|Number of|This is)"
+}
+
+for CASE in "cra_cag_praise_2019-02-03_01-14-16_histogram.dat propmid" "newmodel.txt propsure"
+do
+    set -- $CASE
+    run $1 $2 "-antithetic true"
+    run $1 $2 "-control Rainfall[5]"
+    run $1 $2 "-stratify beta_conflict_famine"
+    run $1 $2 "-splitting 100 -splitruns 4"
+    run $1 $2 "-proposal ce"
+done > "$WORK/output"
+
+if [ "$MODE" = "update" ]
+then
+    cp "$WORK/output" "$DIR/expected"
+    exit 0
+fi
+diff "$DIR/expected" "$WORK/output"